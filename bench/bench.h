@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <cstdio>
+
+// minimum time each measurement runs for, set from the command line
+extern std::chrono::milliseconds bench_min_time;
+
+// Calls fn until at least bench_min_time has passed and returns the average nanoseconds per call
+template <typename F>
+double measure_ns(F&& fn)
+{
+    // warm up caches and branch predictors first
+    fn();
+
+    size_t iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+
+    do
+    {
+        fn();
+        iterations++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    while (elapsed < bench_min_time);
+
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+}
+
+// prints one result as a JSON line so runs can be diffed between versions
+// items: how many units of work (eg. pixels or cells) one call processes
+inline void report(const char* benchmark, const std::string& variant, const std::string& params, double ns_per_call, double items)
+{
+    std::printf("{\"benchmark\": \"%s\", \"variant\": \"%s\", \"params\": \"%s\", \"ns_per_call\": %.1f, \"mitems_per_sec\": %.2f}\n",
+                benchmark, variant.c_str(), params.c_str(), ns_per_call, items * 1000.0 / ns_per_call);
+    std::fflush(stdout);
+}
+
+// reports a benchmark which couldn't run on this machine, eg. without an X display
+inline void report_skipped(const char* benchmark, const std::string& reason)
+{
+    std::printf("{\"benchmark\": \"%s\", \"skipped\": \"%s\"}\n", benchmark, reason.c_str());
+    std::fflush(stdout);
+}
+
+inline std::string size_string(size_t width, size_t height)
+{
+    return std::to_string(width) + "x" + std::to_string(height);
+}
@@ -0,0 +1,76 @@
+#include <vector>
+#include <string>
+
+#include "bench.h"
+#include "synthetic.h"
+#include "quantize.h"
+#include "cell_stream.h"
+
+void run_cell_stream_benchmarks()
+{
+    const size_t grid_sizes[][2] = { { 160, 90 }, { 240, 135 }, { 480, 270 } };
+    const size_t cursor_count = 4;
+    const size_t frame_count = 120;
+    const size_t keyframe_interval = 60;
+
+    for (auto grid_size : grid_sizes)
+    {
+        size_t width = grid_size[0];
+        size_t height = grid_size[1];
+        std::string params = size_string(width, height);
+
+        // the synthetic clip drawn straight at grid size and quantized, as a transcode would produce
+        std::vector<uint8_t> shade_buffer(width * height);
+        std::vector<uint8_t> index_buffer(width * height);
+        ImageBuffer<uint8_t> shades(shade_buffer.data(), width, height);
+        ImageBuffer<uint8_t> indices(index_buffer.data(), width, height);
+        ShadeQuantizer quantizer(cursor_count, DitherMode::Disabled);
+        TemporaryFile file(".cvf");
+        CellStreamWriter writer(width, height, cursor_count, 30, 1, keyframe_interval);
+
+        if (auto err = writer.open(file.path()))
+        {
+            report_skipped("cell_stream", *err);
+
+            return;
+        }
+
+        for (size_t frame = 0; frame < frame_count; frame++)
+        {
+            draw_synthetic_frame(shade_buffer.data(), width, width, height, frame);
+            quantizer.quantize(shades, indices);
+            writer.add_frame(indices, std::chrono::milliseconds(frame * 1000 / 30));
+        }
+
+        if (auto err = writer.finish())
+        {
+            report_skipped("cell_stream", *err);
+
+            return;
+        }
+
+        CellStreamReader reader;
+
+        if (auto err = reader.open(file.path().c_str()))
+        {
+            report_skipped("cell_stream", *err);
+
+            return;
+        }
+
+        params += ", " + std::to_string(reader.file_size() / frame_count) + " bytes per frame";
+
+        // plays the whole clip from the start each call, keyframes included
+        double ns = measure_ns([&]() {
+            for (size_t frame = 0; frame < frame_count; frame++)
+            {
+                reader.apply_frame(frame, indices);
+            }
+        });
+
+        report("cell_stream", "apply_frame", params, ns / frame_count, width * height);
+
+        // worst case random access: the frame right before a keyframe
+        report("cell_stream", "decode_frame", params, measure_ns([&]() { reader.decode_frame(keyframe_interval - 1, indices); }), width * height);
+    }
+}
@@ -0,0 +1,128 @@
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+#include "bench.h"
+#include "synthetic.h"
+#include "compositor.h"
+#include "task_pool.h"
+#include "offscreen_sink.h"
+
+void run_compose_benchmarks()
+{
+    const size_t screen_width = 1920, screen_height = 1080;
+
+    // roughly the cropped sizes of 16, 24 and 48 pixel cursor themes
+    const size_t cursor_sizes[][2] = { { 8, 12 }, { 12, 19 }, { 24, 36 } };
+    const size_t cursor_count = 4;
+
+    std::vector<size_t> thread_counts = { 1 };
+
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+
+    for (auto cursor_size : cursor_sizes)
+    {
+        std::unique_ptr<CursorPixel> cursors = create_synthetic_cursors(cursor_count, cursor_size[0], cursor_size[1]);
+
+        // the kernel unrolled for the cell width against the generic one, single threaded so only the copies differ
+        for (bool specialised : { true, false })
+        {
+            OffscreenSink sink(screen_width, screen_height);
+            FrameCompositor compositor(*cursors, sink, 1, specialised);
+            size_t grid_width = compositor.get_width();
+            size_t grid_height = compositor.get_height();
+            std::string params = size_string(grid_width, grid_height) + " cells of " + size_string(cursor_size[0], cursor_size[1]) +
+                                 (compositor.specialised_blit() ? ", unrolled" : ", generic");
+
+            // runs of 8 cells sharing a shade, like the flat areas of real video, alternated so every cell changes
+            std::vector<uint8_t> frame_buffers[2];
+
+            for (size_t frame = 0; frame < 2; frame++)
+            {
+                frame_buffers[frame].resize(grid_width * grid_height);
+
+                for (size_t i = 0; i < frame_buffers[frame].size(); i++)
+                {
+                    frame_buffers[frame][i] = (uint8_t)(frame + 2 * ((i / 8) % 2));
+                }
+            }
+
+            ImageBuffer<uint8_t> frames[2] = {
+                { frame_buffers[0].data(), grid_width, grid_height },
+                { frame_buffers[1].data(), grid_width, grid_height }
+            };
+
+            size_t frame_index = 0;
+
+            double ns = measure_ns([&]() {
+                compositor.write_frame(frames[frame_index++ % 2]);
+                compositor.present();
+            });
+
+            report("compose", "shade_runs", params, ns, grid_width * grid_height);
+        }
+
+        for (size_t threads : thread_counts)
+        {
+            OffscreenSink sink(screen_width, screen_height);
+            FrameCompositor compositor(*cursors, sink, threads);
+            size_t grid_width = compositor.get_width();
+            size_t grid_height = compositor.get_height();
+            std::string params = size_string(grid_width, grid_height) + " cells of " + size_string(cursor_size[0], cursor_size[1]) +
+                                 ", " + std::to_string(threads) + " threads";
+
+            // two random frames alternated, so every cell changes: the worst case for delta rendering
+            std::vector<uint8_t> frame_buffers[2];
+            std::mt19937 rng(1234);
+
+            for (std::vector<uint8_t>& buffer : frame_buffers)
+            {
+                buffer.resize(grid_width * grid_height);
+
+                for (size_t i = 0; i < buffer.size(); i++)
+                {
+                    // offset by one so the frames can never share a cell
+                    buffer[i] = (uint8_t)((&buffer == &frame_buffers[0] ? 0 : 1) + 2 * (rng() % 2));
+                }
+            }
+
+            ImageBuffer<uint8_t> frames[2] = {
+                { frame_buffers[0].data(), grid_width, grid_height },
+                { frame_buffers[1].data(), grid_width, grid_height }
+            };
+
+            size_t frame_index = 0;
+
+            double ns = measure_ns([&]() {
+                compositor.write_frame(frames[frame_index++ % 2]);
+                compositor.present();
+            });
+
+            report("compose", "all_dirty", params, ns, grid_width * grid_height);
+
+            // the same frame over and over, so nothing changes: the best case
+            ns = measure_ns([&]() {
+                compositor.write_frame(frames[0]);
+                compositor.present();
+            });
+
+            report("compose", "static", params, ns, grid_width * grid_height);
+
+            // the same threads as tasks on a shared pool, as tiled playback composes, for the cost of queueing and stealing bands
+            TaskPool task_pool(threads);
+            OffscreenSink pool_sink(screen_width, screen_height);
+            FrameCompositor pool_compositor(*cursors, pool_sink, task_pool);
+
+            ns = measure_ns([&]() {
+                pool_compositor.write_frame(frames[frame_index++ % 2]);
+                pool_compositor.present();
+            });
+
+            report("compose", "all_dirty_task_pool", params, ns, grid_width * grid_height);
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include <vector>
+#include <cstring>
+#include <utility>
+
+#include "bench.h"
+#include "synthetic.h"
+#include "video_player.h"
+#include "luma_downsample.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+namespace
+{
+    const size_t video_sizes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+    const size_t grid_sizes[][2] = { { 160, 90 }, { 240, 135 }, { 480, 270 } };
+}
+
+void run_decode_benchmarks()
+{
+    const size_t frame_count = 60;
+    const size_t grid_width = 240, grid_height = 135;
+
+    for (auto video_size : video_sizes)
+    {
+        size_t width = video_size[0];
+        size_t height = video_size[1];
+        TemporaryFile file(".mkv");
+
+        if (file.path().empty())
+        {
+            report_skipped("decode", "could not create a temporary file");
+
+            return;
+        }
+
+        if (auto err = write_synthetic_video(file.path(), width, height, frame_count, 30))
+        {
+            report_skipped("decode", *err);
+
+            return;
+        }
+
+        // a single thread against the codec's default threading, then the default threading scaling with swscale
+        for (auto [thread_count, direct_luma] : { std::pair{ 1, true }, std::pair{ 0, true }, std::pair{ 0, false } })
+        {
+            DecoderOptions decoder_options;
+
+            decoder_options.thread_count = thread_count;
+            decoder_options.direct_luma = direct_luma;
+
+            std::vector<uint8_t> buffer(grid_width * grid_height);
+            std::chrono::nanoseconds decode_time(0);
+            size_t frames_decoded = 0;
+            std::string threading;
+
+            // reopen and decode the whole clip until enough time has been measured, leaving out the open itself
+            while (decode_time < bench_min_time)
+            {
+                VideoPlayer video_player;
+
+                if (auto err = video_player.open_video(file.path().c_str(), grid_width, grid_height, decoder_options))
+                {
+                    report_skipped("decode", *err);
+
+                    return;
+                }
+
+                threading = video_player.decoder_threading();
+
+                auto start = std::chrono::steady_clock::now();
+
+                while (video_player.get_next_frame(buffer.data()))
+                {
+                    frames_decoded++;
+                }
+
+                decode_time += std::chrono::steady_clock::now() - start;
+
+                if (frames_decoded == 0)
+                {
+                    report_skipped("decode", "no frames could be decoded");
+
+                    return;
+                }
+            }
+
+            report("decode", "get_next_frame " + threading + (direct_luma ? "" : ", swscale"), size_string(width, height) + "->" + size_string(grid_width, grid_height),
+                   (double)decode_time.count() / frames_decoded, width * height);
+        }
+
+        // a seek to the last frame, the furthest from its keyframe, once the first pass has built the index
+        VideoPlayer video_player;
+        std::vector<uint8_t> buffer(grid_width * grid_height);
+
+        if (video_player.open_video(file.path().c_str(), grid_width, grid_height))
+        {
+            continue;
+        }
+
+        while (video_player.get_next_frame(buffer.data()));
+
+        std::chrono::nanoseconds last_frame(1000000000LL * (frame_count - 1) / 30);
+
+        report("decode", "seek_last_frame", size_string(width, height) + "->" + size_string(grid_width, grid_height), measure_ns([&]() {
+            video_player.seek(last_frame);
+            video_player.get_next_frame(buffer.data());
+        }), 1);
+
+        // the last frame and the wrap back to the first in loop mode, against reopening the file for every pass
+        video_player.set_looping(true);
+
+        report("decode", "loop_wrap", size_string(width, height) + "->" + size_string(grid_width, grid_height), measure_ns([&]() {
+            video_player.seek(last_frame);
+            video_player.get_next_frame(buffer.data());
+            video_player.get_next_frame(buffer.data());
+        }), 1);
+
+        report("decode", "reopen", size_string(width, height) + "->" + size_string(grid_width, grid_height), measure_ns([&]() {
+            VideoPlayer reopened_player;
+
+            reopened_player.open_video(file.path().c_str(), grid_width, grid_height);
+            reopened_player.get_next_frame(buffer.data());
+        }), 1);
+    }
+}
+
+void run_scale_benchmarks()
+{
+    for (auto video_size : video_sizes)
+    {
+        size_t width = video_size[0];
+        size_t height = video_size[1];
+        AVFrame* frame = av_frame_alloc();
+
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = (int)width;
+        frame->height = (int)height;
+
+        if (av_frame_get_buffer(frame, 0) < 0)
+        {
+            av_frame_free(&frame);
+            report_skipped("scale", "could not allocate a frame");
+
+            return;
+        }
+
+        draw_synthetic_frame(frame->data[0], frame->linesize[0], width, height, 0);
+
+        for (size_t y = 0; y < height / 2; y++)
+        {
+            std::memset(frame->data[1] + y * frame->linesize[1], 128, width / 2);
+            std::memset(frame->data[2] + y * frame->linesize[2], 128, width / 2);
+        }
+
+        for (auto grid_size : grid_sizes)
+        {
+            size_t grid_width = grid_size[0];
+            size_t grid_height = grid_size[1];
+            std::vector<uint8_t> buffer(grid_width * grid_height);
+
+            // the same conversion VideoPlayer sets up
+            struct SwsContext* sws_context = sws_getContext((int)width, (int)height, AV_PIX_FMT_YUV420P,
+                                                            (int)grid_width, (int)grid_height, AV_PIX_FMT_GRAY8,
+                                                            SWS_BILINEAR, nullptr, nullptr, nullptr);
+
+            uint8_t* sws_data[AV_NUM_DATA_POINTERS] = { buffer.data() };
+            int sws_linesize[AV_NUM_DATA_POINTERS] = { (int)grid_width };
+
+            double ns = measure_ns([&]() {
+                sws_scale(sws_context, frame->data, frame->linesize, 0, (int)height, sws_data, sws_linesize);
+            });
+
+            report("scale", "sws_bilinear", size_string(width, height) + "->" + size_string(grid_width, grid_height), ns, width * height);
+
+            sws_freeContext(sws_context);
+
+            // what VideoPlayer does instead for YUV video, averaging the Y plane straight down to the grid
+            LumaDownsampler downsampler(width, height, grid_width, grid_height, true);
+
+            ns = measure_ns([&]() {
+                downsampler.downsample(frame->data[0], (size_t)frame->linesize[0], buffer.data());
+            });
+
+            report("scale", "luma_box", size_string(width, height) + "->" + size_string(grid_width, grid_height), ns, width * height);
+        }
+
+        av_frame_free(&frame);
+    }
+}
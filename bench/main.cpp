@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include "bench.h"
+
+void run_decode_benchmarks();
+void run_scale_benchmarks();
+void run_quantize_benchmarks();
+void run_cell_stream_benchmarks();
+void run_compose_benchmarks();
+void run_present_benchmarks();
+
+std::chrono::milliseconds bench_min_time(200);
+
+namespace
+{
+    struct Suite
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    // in pipeline order
+    const Suite suites[] = {
+        { "decode", run_decode_benchmarks },
+        { "scale", run_scale_benchmarks },
+        { "quantize", run_quantize_benchmarks },
+        { "cell_stream", run_cell_stream_benchmarks },
+        { "compose", run_compose_benchmarks },
+        { "present", run_present_benchmarks }
+    };
+
+    void print_usage(const char* program_name)
+    {
+        std::cerr << "usage: " << program_name << " [--min-time <ms>] [suite...]\n"
+                  << "\n"
+                  << "Runs every suite unless some are named. Results are printed as one JSON object per line.\n"
+                  << "suites:";
+
+        for (const Suite& suite : suites) std::cerr << " " << suite.name;
+
+        std::cerr << std::endl;
+    }
+}
+
+int main(int argc, const char* const argv[])
+{
+    bool selected[sizeof(suites) / sizeof(suites[0])] = {};
+    bool any_selected = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+        {
+            bench_min_time = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+
+            continue;
+        }
+
+        bool found = false;
+
+        for (size_t s = 0; s < sizeof(suites) / sizeof(suites[0]); s++)
+        {
+            if (std::strcmp(argv[i], suites[s].name) == 0)
+            {
+                selected[s] = found = any_selected = true;
+            }
+        }
+
+        if (!found)
+        {
+            print_usage(argv[0]);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (size_t s = 0; s < sizeof(suites) / sizeof(suites[0]); s++)
+    {
+        if (!any_selected || selected[s])
+        {
+            suites[s].run();
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
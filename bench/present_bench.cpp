@@ -0,0 +1,171 @@
+#include <vector>
+#include <random>
+
+#include "bench.h"
+#include "synthetic.h"
+#include "compositor.h"
+#include "x11/state.h"
+#include "x11/cursor_window.h"
+#include "x11/glyph_renderer.h"
+#include "x11/pixmap_renderer.h"
+#include "x11/present_window.h"
+
+namespace
+{
+    // two random frames alternated, each changing the given share of cells
+    void create_changing_frames(std::vector<uint8_t> (&frames)[2], size_t cell_count, size_t levels, size_t divisor)
+    {
+        std::mt19937 rng(1234);
+
+        for (std::vector<uint8_t>& frame : frames) frame.assign(cell_count, (uint8_t)levels);
+
+        for (size_t i = 0; i < cell_count; i += divisor)
+        {
+            frames[0][i] = (uint8_t)(rng() % levels);
+            frames[1][i] = (uint8_t)((frames[0][i] + 1) % levels);
+        }
+    }
+
+    // renders the alternating frames through the renderer, including the server finishing each one
+    void measure_renderer(X11State& x11, FrameRenderer& renderer, const char* variant, size_t levels)
+    {
+        for (size_t divisor : { 1, 10 })
+        {
+            std::vector<uint8_t> frame_buffers[2];
+
+            create_changing_frames(frame_buffers, renderer.cell_count(), levels, divisor);
+
+            ImageBuffer<uint8_t> frames[2] = {
+                { frame_buffers[0].data(), renderer.get_width(), renderer.get_height() },
+                { frame_buffers[1].data(), renderer.get_width(), renderer.get_height() }
+            };
+
+            size_t frame_index = 0;
+            uint64_t bytes_before = renderer.bytes_sent();
+
+            double ns = measure_ns([&]() {
+                renderer.write_frame(frames[frame_index++ % 2]);
+                renderer.present();
+                XSync(x11.display, False);
+            });
+
+            std::string params = size_string(renderer.get_width(), renderer.get_height()) + " cells, " + std::to_string(100 / divisor) + "% changing, " +
+                                 std::to_string((renderer.bytes_sent() - bytes_before) / frame_index / 1024) + "KB sent per frame";
+
+            report("present", variant, params, ns, renderer.cell_count() / divisor);
+        }
+    }
+}
+
+void run_present_benchmarks()
+{
+    // X11State exits when there's no display, so check first
+    Display* display = XOpenDisplay(nullptr);
+
+    if (!display)
+    {
+        report_skipped("present", "no X display, run under eg. xvfb-run");
+
+        return;
+    }
+
+    XCloseDisplay(display);
+
+    X11State x11;
+
+    for (bool use_shm : { true, false })
+    {
+        CursorOverlayWindow window(x11);
+
+        if (window.create_window(use_shm))
+        {
+            report_skipped("present", "could not create a window");
+
+            return;
+        }
+
+        if (use_shm && !window.using_shm())
+        {
+            report_skipped("present", "MIT-SHM is not available");
+
+            continue;
+        }
+
+        ImageBuffer<uint32_t>& backbuffer = window.backbuffer();
+        const char* variant = use_shm ? "shm" : "putimage";
+
+        // a full frame, and a tenth of one like a typical frame with delta rendering
+        for (size_t divisor : { 1, 10 })
+        {
+            std::vector<RectangleRegion> regions = { { 0, 0, backbuffer.width, backbuffer.height / divisor } };
+
+            double ns = measure_ns([&]() {
+                window.present(regions);
+
+                // wait for the server as well, so both paths are measured up to the frame being on screen
+                XSync(x11.display, False);
+            });
+
+            report("present", variant, size_string(regions[0].width, regions[0].height), ns, regions[0].width * regions[0].height);
+        }
+    }
+
+    // whole frames of cursors against sending cell indices to server side glyphs
+    const size_t cursor_count = 4;
+    std::unique_ptr<CursorPixel> cursors = create_synthetic_cursors(cursor_count, 12, 19);
+
+    {
+        CursorOverlayWindow window(x11);
+
+        if (window.create_window(false))
+        {
+            report_skipped("present", "could not create a window");
+
+            return;
+        }
+
+        FrameCompositor compositor(*cursors, window);
+
+        measure_renderer(x11, compositor, "compose_putimage", cursor_count);
+    }
+
+    {
+        PresentWindow window(x11);
+
+        // paced by the server's (possibly fake) vblank, so this measures the display's rate more than the client
+        if (window.create_window())
+        {
+            report_skipped("present", "the Present extension is not available");
+        }
+        else
+        {
+            FrameCompositor compositor(*cursors, window);
+
+            measure_renderer(x11, compositor, "compose_present", cursor_count);
+        }
+    }
+
+    {
+        PixmapTileRenderer pixmap_renderer(x11, *cursors);
+
+        if (pixmap_renderer.create_window())
+        {
+            report_skipped("present", "could not create a window");
+
+            return;
+        }
+
+        measure_renderer(x11, pixmap_renderer, "pixmap_tiles", cursor_count);
+    }
+
+    GlyphSetRenderer glyph_renderer(x11, *cursors);
+
+    if (glyph_renderer.create_window())
+    {
+        report_skipped("present", "XRender is not available");
+
+        return;
+    }
+
+    measure_renderer(x11, glyph_renderer, "xrender_glyphs", cursor_count);
+}
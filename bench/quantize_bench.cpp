@@ -0,0 +1,59 @@
+#include <vector>
+#include <random>
+#include <string>
+
+#include "bench.h"
+#include "quantize.h"
+#include "x11/cursor_pixel.h"
+
+void run_quantize_benchmarks()
+{
+    const size_t grid_sizes[][2] = { { 160, 90 }, { 240, 135 }, { 480, 270 } };
+
+    // read at runtime so the per-cell division can't be folded into a constant
+    volatile size_t cursor_count_source = 4;
+    size_t cursor_count = cursor_count_source;
+
+    for (auto grid_size : grid_sizes)
+    {
+        size_t width = grid_size[0];
+        size_t height = grid_size[1];
+        std::string params = size_string(width, height);
+
+        std::vector<uint8_t> shade_buffer(width * height);
+        std::vector<uint8_t> index_buffer(width * height);
+        std::mt19937 rng(1234);
+
+        for (uint8_t& shade : shade_buffer) shade = (uint8_t)rng();
+
+        ImageBuffer<uint8_t> shades(shade_buffer.data(), width, height);
+        ImageBuffer<uint8_t> indices(index_buffer.data(), width, height);
+
+        // what write_frame did before the quantization stage: one multiply and divide per cell
+        double ns = measure_ns([&]() {
+            for (size_t i = 0; i < width * height; i++)
+            {
+                index_buffer[i] = (uint8_t)CursorPixel::shade_to_index(shade_buffer[i], cursor_count);
+            }
+        });
+
+        report("quantize", "get_cursor_index", params, ns, width * height);
+
+        for (QuantizeKernel kernel : { QuantizeKernel::Scalar, QuantizeKernel::SSE2, QuantizeKernel::AVX2 })
+        {
+            if (!ShadeQuantizer::kernel_supported(kernel)) continue;
+
+            ShadeQuantizer quantizer(cursor_count, DitherMode::Disabled, kernel);
+
+            report("quantize", ShadeQuantizer::kernel_name(kernel), params, measure_ns([&]() { quantizer.quantize(shades, indices); }), width * height);
+
+            ShadeQuantizer ordered_quantizer(cursor_count, DitherMode::Ordered, kernel);
+
+            report("quantize", std::string(ShadeQuantizer::kernel_name(kernel)) + "_ordered", params, measure_ns([&]() { ordered_quantizer.quantize(shades, indices); }), width * height);
+        }
+
+        ShadeQuantizer diffusion_quantizer(cursor_count, DitherMode::ErrorDiffusion);
+
+        report("quantize", "error_diffusion", params, measure_ns([&]() { diffusion_quantizer.quantize(shades, indices); }), width * height);
+    }
+}
@@ -0,0 +1,210 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "synthetic.h"
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+}
+
+namespace
+{
+    // sends frame (null to flush) and writes out every packet the encoder produces
+    bool encode_frame(AVCodecContext* codec_context, AVFormatContext* format_context, AVStream* stream, AVFrame* frame, AVPacket* packet)
+    {
+        if (avcodec_send_frame(codec_context, frame) < 0)
+        {
+            return false;
+        }
+
+        while (true)
+        {
+            int response = avcodec_receive_packet(codec_context, packet);
+
+            if (response == AVERROR(EAGAIN) || response == AVERROR_EOF)
+            {
+                return true;
+            }
+            else if (response < 0)
+            {
+                return false;
+            }
+
+            av_packet_rescale_ts(packet, codec_context->time_base, stream->time_base);
+            packet->stream_index = stream->index;
+
+            if (av_interleaved_write_frame(format_context, packet) < 0)
+            {
+                return false;
+            }
+        }
+    }
+}
+
+void draw_synthetic_frame(uint8_t* pixels, size_t stride, size_t width, size_t height, size_t frame_index)
+{
+    double t = frame_index / 30.0;
+    double blob_x = width * (0.5 + 0.35 * std::sin(t * 1.3));
+    double blob_y = height * (0.5 + 0.35 * std::cos(t * 0.9));
+    double radius = std::min(width, height) * 0.25;
+
+    for (size_t y = 0; y < height; y++)
+    {
+        for (size_t x = 0; x < width; x++)
+        {
+            double dx = x - blob_x;
+            double dy = y - blob_y;
+            double distance = std::sqrt(dx * dx + dy * dy) / radius;
+
+            // hard edged blob like Bad Apple's silhouettes, over a soft gradient
+            int background = 160 + (int)(95.0 * x / width);
+
+            pixels[y * stride + x] = distance < 1.0 ? (uint8_t)(distance * 40) : (uint8_t)background;
+        }
+    }
+}
+
+std::optional<std::string> write_synthetic_video(const std::string& filename, size_t width, size_t height, size_t frame_count, int fps)
+{
+    AVFormatContext* format_context = nullptr;
+
+    if (avformat_alloc_output_context2(&format_context, nullptr, "matroska", filename.c_str()) < 0)
+    {
+        return "could not create the matroska muxer";
+    }
+
+    // MPEG-4 part 2 is built into every ffmpeg, unlike H.264 encoders
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    AVStream* stream = avformat_new_stream(format_context, nullptr);
+    AVCodecContext* codec_context = codec ? avcodec_alloc_context3(codec) : nullptr;
+    AVFrame* frame = av_frame_alloc();
+    AVPacket* packet = av_packet_alloc();
+    std::optional<std::string> err;
+
+    if (!codec || !stream || !codec_context || !frame || !packet)
+    {
+        err = "could not set up the MPEG-4 encoder";
+    }
+    else
+    {
+        codec_context->width = (int)width;
+        codec_context->height = (int)height;
+        codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
+        codec_context->time_base = { 1, fps };
+        codec_context->framerate = { fps, 1 };
+        codec_context->gop_size = fps;
+        codec_context->bit_rate = (int64_t)width * height * fps / 4;
+
+        // only a hint, the muxer picks the final time base in avformat_write_header()
+        stream->time_base = codec_context->time_base;
+
+        if (format_context->oformat->flags & AVFMT_GLOBALHEADER)
+        {
+            codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
+        frame->format = codec_context->pix_fmt;
+        frame->width = codec_context->width;
+        frame->height = codec_context->height;
+
+        if (avcodec_open2(codec_context, codec, nullptr) < 0 ||
+        avcodec_parameters_from_context(stream->codecpar, codec_context) < 0 ||
+        av_frame_get_buffer(frame, 0) < 0)
+        {
+            err = "could not open the MPEG-4 encoder";
+        }
+        else if (avio_open(&format_context->pb, filename.c_str(), AVIO_FLAG_WRITE) < 0 || avformat_write_header(format_context, nullptr) < 0)
+        {
+            err = "could not write " + filename;
+        }
+        else
+        {
+            for (size_t i = 0; i < frame_count && !err; i++)
+            {
+                av_frame_make_writable(frame);
+
+                draw_synthetic_frame(frame->data[0], frame->linesize[0], width, height, i);
+
+                for (size_t y = 0; y < height / 2; y++)
+                {
+                    std::memset(frame->data[1] + y * frame->linesize[1], 128, width / 2);
+                    std::memset(frame->data[2] + y * frame->linesize[2], 128, width / 2);
+                }
+
+                frame->pts = (int64_t)i;
+
+                if (!encode_frame(codec_context, format_context, stream, frame, packet))
+                {
+                    err = "encoding failed";
+                }
+            }
+
+            if (!err && (!encode_frame(codec_context, format_context, stream, nullptr, packet) || av_write_trailer(format_context) < 0))
+            {
+                err = "encoding failed";
+            }
+        }
+    }
+
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&codec_context);
+
+    if (format_context->pb) avio_closep(&format_context->pb);
+
+    avformat_free_context(format_context);
+
+    return err;
+}
+
+std::unique_ptr<CursorPixel> create_synthetic_cursors(size_t count, size_t width, size_t height)
+{
+    std::vector<uint32_t> atlas;
+    std::vector<size_t> sizes;
+
+    for (size_t shade = 0; shade < count; shade++)
+    {
+        uint8_t grey = (uint8_t)(255 * shade / count);
+
+        for (size_t y = 0; y < height; y++)
+        {
+            for (size_t x = 0; x < width; x++)
+            {
+                // an arrow-ish triangle: opaque inside, transparent outside
+                bool inside = x * height <= y * width;
+
+                atlas.push_back(inside ? 0xff000000u | grey << 16 | grey << 8 | grey : 0);
+            }
+        }
+
+        sizes.push_back(width);
+        sizes.push_back(height);
+    }
+
+    return std::make_unique<CursorPixel>(std::move(atlas), sizes);
+}
+
+TemporaryFile::TemporaryFile(const char* suffix)
+{
+    const char* directory = std::getenv("TMPDIR");
+    std::string path = std::string(directory ? directory : "/tmp") + "/cursor-video-bench-XXXXXX" + suffix;
+    int fd = mkstemps(path.data(), (int)std::strlen(suffix));
+
+    if (fd >= 0)
+    {
+        close(fd);
+
+        _path = path;
+    }
+}
+
+TemporaryFile::~TemporaryFile()
+{
+    if (!_path.empty())
+    {
+        unlink(_path.c_str());
+    }
+}
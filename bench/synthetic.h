@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "x11/cursor_pixel.h"
+
+// Encodes a short clip of a dark blob moving over a light gradient, which
+// decodes like real footage without needing any sample files.
+// returns an error message on failure
+std::optional<std::string> write_synthetic_video(const std::string& filename, size_t width, size_t height, size_t frame_count, int fps);
+
+// fills a grey frame with the same pattern as write_synthetic_video()
+void draw_synthetic_frame(uint8_t* pixels, size_t stride, size_t width, size_t height, size_t frame_index);
+
+// shades of the given size with a cursor-like alpha edge, darkest first
+std::unique_ptr<CursorPixel> create_synthetic_cursors(size_t count, size_t width, size_t height);
+
+// a temporary file path with the given suffix which is removed on destruction
+class TemporaryFile
+{
+private:
+    std::string _path;
+
+public:
+    TemporaryFile(const char* suffix);
+    TemporaryFile(const TemporaryFile&) = delete;
+
+    const std::string& path() const
+    {
+        return _path;
+    }
+
+    ~TemporaryFile();
+};
@@ -0,0 +1,77 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "aligned_buffer.h"
+#include "misc.h"
+
+namespace
+{
+    // the common huge page size on x86-64, other sizes just fail MAP_HUGETLB and fall back
+    const size_t huge_page_size = 2 * 1024 * 1024;
+}
+
+void* aligned_allocate(size_t bytes, size_t& mapped_bytes, bool& huge_pages)
+{
+    mapped_bytes = 0;
+    huge_pages = false;
+
+    if (bytes >= huge_page_size)
+    {
+        size_t huge_length = round_up_div(bytes, huge_page_size) * huge_page_size;
+
+        // reserved huge pages come whole, so only use them when rounding up wastes little (eg. not 4MB for a 2.1MB plane)
+        if (huge_length - bytes <= bytes / 8)
+        {
+            void* data = mmap(nullptr, huge_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (data != MAP_FAILED)
+            {
+                mapped_bytes = huge_length;
+                huge_pages = true;
+
+                return data;
+            }
+        }
+
+        // otherwise let the kernel back whatever it can with transparent huge pages
+        size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        size_t length = round_up_div(bytes, page_size) * page_size;
+        void* data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (data == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        madvise(data, length, MADV_HUGEPAGE);
+        mapped_bytes = length;
+
+        return data;
+    }
+
+    // aligned_alloc wants a multiple of the alignment, and mustn't be asked for nothing
+    size_t length = std::max(round_up_div(bytes, buffer_alignment), (size_t)1) * buffer_alignment;
+    void* data = std::aligned_alloc(buffer_alignment, length);
+
+    if (data)
+    {
+        std::memset(data, 0, length);
+    }
+
+    return data;
+}
+
+void aligned_free(void* data, size_t mapped_bytes)
+{
+    if (mapped_bytes)
+    {
+        munmap(data, mapped_bytes);
+    }
+    else
+    {
+        std::free(data);
+    }
+}
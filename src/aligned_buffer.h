@@ -0,0 +1,67 @@
+#pragma once
+
+#include <new>
+#include <cstddef>
+
+// alignment of every AlignedBuffer, a cache line so SIMD loads never split one and threads never share one
+constexpr size_t buffer_alignment = 64;
+
+// zeroed memory aligned to buffer_alignment, returns null on failure
+// allocations of a huge page or more are mapped with MAP_HUGETLB when the system has huge pages reserved,
+// otherwise advised to use transparent huge pages, so sweeping them every frame takes fewer TLB misses
+// mapped_bytes: set to the size of the mapping to pass to aligned_free(), 0 for small heap allocations
+// huge_pages: set when the memory is backed by reserved huge pages
+void* aligned_allocate(size_t bytes, size_t& mapped_bytes, bool& huge_pages);
+void aligned_free(void* data, size_t mapped_bytes);
+
+// Buffer for the big per-frame planes (grey frames, cell indices, backbuffers),
+// allocated once before playback so the steady state never touches the heap
+template <typename T>
+class AlignedBuffer
+{
+private:
+    T* _data;
+    size_t _count;
+    size_t _mapped_bytes;
+    bool _huge_pages;
+
+public:
+    // count: number of zeroed elements
+    explicit AlignedBuffer(size_t count)
+    :
+    _data(nullptr),
+    _count(count),
+    _mapped_bytes(0),
+    _huge_pages(false)
+    {
+        _data = static_cast<T*>(aligned_allocate(count * sizeof(T), _mapped_bytes, _huge_pages));
+
+        if (!_data)
+        {
+            throw std::bad_alloc();
+        }
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    T* data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _count;
+    }
+
+    bool huge_pages() const
+    {
+        return _huge_pages;
+    }
+
+    ~AlignedBuffer()
+    {
+        aligned_free(_data, _mapped_bytes);
+    }
+};
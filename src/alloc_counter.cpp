@@ -0,0 +1,98 @@
+#include "alloc_counter.h"
+
+#ifdef CURSOR_VIDEO_COUNT_ALLOCS
+
+#include <atomic>
+#include <cstddef>
+#include <cerrno>
+
+// glibc's own allocator, which the replacements below forward to
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+    std::atomic<uint64_t> total_allocations(0);
+
+    // initial-exec TLS, so counting never allocates and works before the thread is fully set up
+    __attribute__((tls_model("initial-exec"))) thread_local uint64_t thread_allocations = 0;
+
+    void count_allocation()
+    {
+        total_allocations.fetch_add(1, std::memory_order_relaxed);
+        thread_allocations++;
+    }
+}
+
+uint64_t heap_allocations()
+{
+    return total_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t thread_heap_allocations()
+{
+    return thread_allocations;
+}
+
+// operator new goes through malloc, so this catches C++ allocations too
+extern "C" void* malloc(size_t size)
+{
+    count_allocation();
+
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    count_allocation();
+
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size)
+{
+    count_allocation();
+
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+    count_allocation();
+
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+    count_allocation();
+
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    count_allocation();
+
+    void* allocation = __libc_memalign(alignment, size);
+
+    if (!allocation)
+    {
+        return ENOMEM;
+    }
+
+    *pointer = allocation;
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Allocation counting is only compiled in with -DCURSOR_VIDEO_COUNT_ALLOCS (make COUNT_ALLOCS=1).
+// It replaces malloc and friends for the whole process, so allocations made inside libav, Xlib
+// and the C++ runtime are counted as well as our own, which is what shows playback has stopped allocating.
+#ifdef CURSOR_VIDEO_COUNT_ALLOCS
+
+// allocations made by every thread so far
+uint64_t heap_allocations();
+
+// allocations made by the calling thread so far
+uint64_t thread_heap_allocations();
+
+#endif
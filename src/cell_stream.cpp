@@ -0,0 +1,488 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+
+#include "cell_stream.h"
+#include "trace.h"
+
+namespace
+{
+    const char cell_stream_magic[8] = { 'C', 'U', 'R', 'S', 'C', 'E', 'L', 'L' };
+    const uint32_t cell_stream_version = 1;
+
+    // a fill op costs two bytes, so shorter runs are cheaper as part of a literal
+    const size_t min_fill_run = 4;
+
+    bool read_varint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+    {
+        value = 0;
+
+        for (unsigned shift = 0; data < end && shift < 64; shift += 7)
+        {
+            uint8_t byte = *data++;
+
+            value |= (uint64_t)(byte & 0x7f) << shift;
+
+            if (!(byte & 0x80)) return true;
+        }
+
+        return false;
+    }
+}
+
+CellStreamWriter::CellStreamWriter(size_t width, size_t height, size_t levels, uint32_t frame_rate_num, uint32_t frame_rate_den, size_t keyframe_interval)
+:
+_file(nullptr),
+_header(),
+_keyframe_interval(std::max<size_t>(keyframe_interval, 1)),
+_frames_since_keyframe(0),
+_previous(width * height),
+_offset(0)
+{
+    std::memcpy(_header.magic, cell_stream_magic, sizeof(_header.magic));
+    _header.version = cell_stream_version;
+    _header.width = width;
+    _header.height = height;
+    _header.levels = levels;
+    _header.frame_rate_num = frame_rate_num;
+    _header.frame_rate_den = frame_rate_den;
+}
+
+std::optional<std::string> CellStreamWriter::open(const std::string& filename)
+{
+    _file = std::fopen(filename.c_str(), "wb");
+
+    if (!_file)
+    {
+        return "could not write " + filename;
+    }
+
+    // written again with the frame count and index once finished
+    if (std::fwrite(&_header, sizeof(_header), 1, _file) != 1)
+    {
+        return "could not write " + filename;
+    }
+
+    _offset = sizeof(_header);
+
+    return {};
+}
+
+void CellStreamWriter::write_op(CellStreamOp op, size_t count)
+{
+    uint64_t value = (uint64_t)(count - 1) << 2 | (uint64_t)op;
+
+    while (value >= 0x80)
+    {
+        _payload.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+
+    _payload.push_back((uint8_t)value);
+}
+
+void CellStreamWriter::encode_frame(const uint8_t* cells, bool keyframe)
+{
+    const uint8_t* previous = _previous.data();
+    size_t cell_count = _previous.size();
+
+    auto unchanged = [&](size_t i) {
+        return !keyframe && cells[i] == previous[i];
+    };
+
+    // length of the run of equal cells starting at i, counting no further than limit
+    auto run_length = [&](size_t i, size_t limit) {
+        size_t length = 1;
+
+        while (i + length < cell_count && length < limit && cells[i + length] == cells[i]) length++;
+
+        return length;
+    };
+
+    _payload.clear();
+
+    size_t i = 0;
+
+    while (i < cell_count)
+    {
+        if (unchanged(i))
+        {
+            size_t length = 1;
+
+            while (i + length < cell_count && unchanged(i + length)) length++;
+
+            // cells past the last op are left as they are, so a trailing skip isn't written
+            if (i + length < cell_count)
+            {
+                write_op(CellStreamOp::Skip, length);
+            }
+
+            i += length;
+
+            continue;
+        }
+
+        size_t run = run_length(i, cell_count);
+
+        if (run >= min_fill_run)
+        {
+            write_op(CellStreamOp::Fill, run);
+            _payload.push_back(cells[i]);
+            i += run;
+
+            continue;
+        }
+
+        // extend the literal until a skip or a fill would be cheaper than carrying on
+        size_t length = run;
+
+        while (i + length < cell_count)
+        {
+            size_t next = i + length;
+
+            if (unchanged(next) && (next + 1 == cell_count || unchanged(next + 1))) break;
+            if (run_length(next, min_fill_run) >= min_fill_run) break;
+
+            length++;
+        }
+
+        write_op(CellStreamOp::Literal, length);
+        _payload.insert(_payload.end(), cells + i, cells + i + length);
+        i += length;
+    }
+}
+
+std::optional<std::string> CellStreamWriter::add_frame(const ImageBuffer<uint8_t>& indices, std::chrono::nanoseconds pts)
+{
+    bool keyframe = _index.empty() || _frames_since_keyframe >= _keyframe_interval;
+
+    encode_frame(indices.pixels, keyframe);
+
+    if (!_payload.empty() && std::fwrite(_payload.data(), _payload.size(), 1, _file) != 1)
+    {
+        return std::string("could not write frame ") + std::to_string(_index.size());
+    }
+
+    _index.push_back({ _offset, (int64_t)pts.count(), (uint32_t)_payload.size(), keyframe ? CELL_STREAM_KEYFRAME : 0 });
+    _offset += _payload.size();
+    _frames_since_keyframe = keyframe ? 1 : _frames_since_keyframe + 1;
+
+    std::memcpy(_previous.data(), indices.pixels, _previous.size());
+
+    return {};
+}
+
+std::optional<std::string> CellStreamWriter::finish()
+{
+    _header.frame_count = _index.size();
+    _header.index_offset = _offset;
+
+    bool written = (_index.empty() || std::fwrite(_index.data(), sizeof(CellStreamIndexEntry), _index.size(), _file) == _index.size()) &&
+                   std::fseek(_file, 0, SEEK_SET) == 0 &&
+                   std::fwrite(&_header, sizeof(_header), 1, _file) == 1;
+
+    _offset += _index.size() * sizeof(CellStreamIndexEntry);
+
+    bool closed = std::fclose(_file) == 0;
+
+    _file = nullptr;
+
+    if (!written || !closed)
+    {
+        return "could not write the frame index";
+    }
+
+    return {};
+}
+
+CellStreamWriter::~CellStreamWriter()
+{
+    if (_file)
+    {
+        std::fclose(_file);
+    }
+}
+
+bool CellStreamReader::is_cell_stream(const char* filename)
+{
+    struct stat file_stat;
+
+    // reading the magic out of a pipe or socket would take it away from the demuxer
+    if (stat(filename, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        return false;
+    }
+
+    FILE* file = std::fopen(filename, "rb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[sizeof(cell_stream_magic)];
+    bool matches = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, cell_stream_magic, sizeof(magic)) == 0;
+
+    std::fclose(file);
+
+    return matches;
+}
+
+std::optional<std::string> CellStreamReader::open(const char* filename)
+{
+    int fd = ::open(filename, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return std::string("could not open ") + filename;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(CellStreamHeader))
+    {
+        close(fd);
+
+        return std::string(filename) + " is not a cursor cell stream";
+    }
+
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return std::string("could not map ") + filename;
+    }
+
+    _data = (const uint8_t*)data;
+    _size = file_stat.st_size;
+
+    // looping content gets read over and over, so fault it all in up front rather than mid-playback
+    madvise(data, _size, MADV_WILLNEED);
+
+    std::memcpy(&_header, _data, sizeof(_header));
+
+    if (std::memcmp(_header.magic, cell_stream_magic, sizeof(cell_stream_magic)) != 0)
+    {
+        return std::string(filename) + " is not a cursor cell stream";
+    }
+
+    if (_header.version != cell_stream_version)
+    {
+        return std::string(filename) + " is cell stream version " + std::to_string(_header.version) + ", only version " + std::to_string(cell_stream_version) + " is supported";
+    }
+
+    if (_header.width == 0 || _header.height == 0 || _header.levels > 255 ||
+        _header.index_offset < sizeof(_header) || _header.index_offset > _size ||
+        _header.frame_count > (_size - _header.index_offset) / sizeof(CellStreamIndexEntry))
+    {
+        return std::string(filename) + " is truncated or corrupt";
+    }
+
+    // checked once here so frames can be decoded without bounds checks on the index
+    for (size_t i = 0; i < _header.frame_count; i++)
+    {
+        CellStreamIndexEntry entry = index_entry(i);
+
+        if (entry.offset < sizeof(_header) || entry.offset > _header.index_offset || entry.size > _header.index_offset - entry.offset)
+        {
+            return std::string(filename) + " has a corrupt index at frame " + std::to_string(i);
+        }
+    }
+
+    if (_header.frame_count && !is_keyframe(0))
+    {
+        return std::string(filename) + " does not start with a keyframe";
+    }
+
+    return {};
+}
+
+CellStreamIndexEntry CellStreamReader::index_entry(size_t frame) const
+{
+    // payloads have any length, so entries aren't necessarily aligned
+    CellStreamIndexEntry entry;
+
+    std::memcpy(&entry, _data + _header.index_offset + frame * sizeof(entry), sizeof(entry));
+
+    return entry;
+}
+
+bool CellStreamReader::apply_frame(size_t frame, ImageBuffer<uint8_t>& indices) const
+{
+    CellStreamIndexEntry entry = index_entry(frame);
+    const uint8_t* data = _data + entry.offset;
+    const uint8_t* end = data + entry.size;
+    uint8_t* cells = indices.pixels;
+    size_t cell_count = indices.width * indices.height;
+    size_t i = 0;
+
+    while (data < end)
+    {
+        uint64_t value;
+
+        if (!read_varint(data, end, value)) return false;
+
+        CellStreamOp op = (CellStreamOp)(value & 3);
+        uint64_t count = (value >> 2) + 1;
+
+        if (count > cell_count - i) return false;
+
+        switch (op)
+        {
+        case CellStreamOp::Skip:
+            break;
+
+        case CellStreamOp::Fill:
+            if (data == end || *data > _header.levels) return false;
+
+            std::memset(cells + i, *data++, count);
+
+            break;
+
+        case CellStreamOp::Literal:
+            if (count > (size_t)(end - data)) return false;
+
+            // an index past the blank one would read past the cursor images
+            if (*std::max_element(data, data + count) > _header.levels) return false;
+
+            std::memcpy(cells + i, data, count);
+            data += count;
+
+            break;
+
+        default:
+            return false;
+        }
+
+        i += count;
+    }
+
+    return true;
+}
+
+bool CellStreamReader::decode_frame(size_t frame, ImageBuffer<uint8_t>& indices) const
+{
+    size_t keyframe = frame;
+
+    while (keyframe > 0 && !is_keyframe(keyframe)) keyframe--;
+
+    for (size_t i = keyframe; i <= frame; i++)
+    {
+        if (!apply_frame(i, indices)) return false;
+    }
+
+    return true;
+}
+
+CellStreamReader::~CellStreamReader()
+{
+    if (_data)
+    {
+        munmap((void*)_data, _size);
+    }
+}
+
+CellStreamSource::CellStreamSource(size_t width, size_t height)
+:
+_index_buffer(width * height),
+_indices(_index_buffer.data(), width, height),
+_next_frame(0),
+_looping(false),
+_loop_offset(0)
+{
+}
+
+std::optional<std::string> CellStreamSource::open(const char* filename, size_t levels)
+{
+    if (auto err = _reader.open(filename))
+    {
+        return err;
+    }
+
+    if (_reader.width() != _indices.width || _reader.height() != _indices.height)
+    {
+        std::ostringstream err;
+
+        err << "was transcoded for a " << _reader.width() << "x" << _reader.height() << " cell grid but the screen needs "
+            << _indices.width << "x" << _indices.height << ", transcode it again with --grid " << _indices.width << "x" << _indices.height;
+
+        return err.str();
+    }
+
+    if (_reader.levels() != levels)
+    {
+        return "was transcoded for " + std::to_string(_reader.levels()) + " cursor shades but " + std::to_string(levels) + " are loaded";
+    }
+
+    return {};
+}
+
+std::optional<std::string> CellStreamSource::seek(std::chrono::nanoseconds timestamp)
+{
+    // frames are stored in presentation order, so the index is sorted by time
+    size_t first = 0, last = _reader.frame_count();
+
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+
+        if (_reader.pts(middle) < timestamp) first = middle + 1;
+        else last = middle;
+    }
+
+    if (first == _reader.frame_count())
+    {
+        return "the seek position is past the end";
+    }
+
+    // the frame before the target is rebuilt from its keyframe, next_frame() then applies the target on top
+    if (first > 0 && !_reader.decode_frame(first - 1, _indices))
+    {
+        return "frame " + std::to_string(first - 1) + " is corrupt";
+    }
+
+    _next_frame = first;
+    _loop_offset = std::chrono::nanoseconds(0);
+
+    return {};
+}
+
+bool CellStreamSource::next_frame(std::chrono::nanoseconds& pts)
+{
+    size_t frame_count = _reader.frame_count();
+
+    if (_next_frame >= frame_count)
+    {
+        if (!_looping || frame_count == 0)
+        {
+            return false;
+        }
+
+        // the first frame is always a keyframe, so wrapping needs nothing but the offset
+        std::chrono::nanoseconds frame_duration(_reader.framerate() > 0.0 ? (int64_t)(1e9 / _reader.framerate()) : 0);
+
+        _loop_offset += _reader.pts(frame_count - 1) - _reader.pts(0) + frame_duration;
+        _next_frame = 0;
+    }
+
+    // every frame is applied even if it ends up dropped, as the next delta builds on it
+    if (!TRACE_CALL(ApplyCellStream, _reader.apply_frame(_next_frame, _indices)))
+    {
+        std::cerr << "error: frame " << _next_frame << " of the cell stream is corrupt" << std::endl;
+
+        return false;
+    }
+
+    pts = _loop_offset + _reader.pts(_next_frame);
+    _next_frame++;
+
+    return true;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#include "misc.h"
+#include "aligned_buffer.h"
+#include "frame_source.h"
+
+// Precompiled cursor video: the planes of cursor indices for every frame,
+// so looping content plays back without decoding, scaling or quantizing.
+//
+// Layout (native byte order):
+//   CellStreamHeader
+//   frame payloads, back to back
+//   CellStreamIndexEntry for every frame, at header.index_offset
+//
+// A payload is a list of ops, each a LEB128 varint of ((cell count - 1) << 2 | op)
+// followed by the op's data. Cells are walked in row order and cells past the
+// last op keep their previous index. Keyframes never skip, so they can be
+// decoded without the frames before them.
+struct CellStreamHeader
+{
+    char magic[8];
+    uint32_t version;
+
+    // size of the cell grid
+    uint32_t width, height;
+
+    // number of cursor shades the indices were quantized to, index == levels is a blank cell
+    uint32_t levels;
+    uint32_t frame_rate_num, frame_rate_den;
+    uint64_t frame_count;
+    uint64_t index_offset;
+};
+
+struct CellStreamIndexEntry
+{
+    uint64_t offset;
+    int64_t pts_ns;
+    uint32_t size;
+    uint32_t flags;
+};
+
+static_assert(sizeof(CellStreamHeader) == 48, "the header is written to files as it is");
+static_assert(sizeof(CellStreamIndexEntry) == 24, "index entries are written to files as they are");
+
+enum class CellStreamOp : uint8_t
+{
+    Skip,   // cells keep their previous index
+    Fill,   // followed by one index, which every cell is set to
+    Literal // followed by an index for each cell
+};
+
+constexpr uint32_t CELL_STREAM_KEYFRAME = 1;
+
+// Transcodes planes of cursor indices into a cell stream file
+class CellStreamWriter
+{
+private:
+    FILE* _file;
+    CellStreamHeader _header;
+    size_t _keyframe_interval;
+    size_t _frames_since_keyframe;
+    std::vector<CellStreamIndexEntry> _index;
+
+    // the last frame written, which delta frames are encoded against
+    std::vector<uint8_t> _previous;
+    std::vector<uint8_t> _payload;
+    uint64_t _offset;
+
+    void write_op(CellStreamOp op, size_t count);
+    void encode_frame(const uint8_t* cells, bool keyframe);
+
+public:
+    // width, height: size of the cell grid
+    // levels: number of cursor shades
+    // keyframe_interval: a frame which decodes on its own every this many frames, for random access
+    CellStreamWriter(size_t width, size_t height, size_t levels, uint32_t frame_rate_num, uint32_t frame_rate_den, size_t keyframe_interval);
+    CellStreamWriter(const CellStreamWriter&) = delete;
+
+    std::optional<std::string> open(const std::string& filename);
+
+    std::optional<std::string> add_frame(const ImageBuffer<uint8_t>& indices, std::chrono::nanoseconds pts);
+
+    // writes the frame index and the final header
+    std::optional<std::string> finish();
+
+    size_t frames() const
+    {
+        return _index.size();
+    }
+
+    uint64_t bytes_written() const
+    {
+        return _offset;
+    }
+
+    ~CellStreamWriter();
+};
+
+// Memory maps a cell stream file for playback
+class CellStreamReader
+{
+private:
+    const uint8_t* _data;
+    size_t _size;
+    CellStreamHeader _header;
+
+    CellStreamIndexEntry index_entry(size_t frame) const;
+
+public:
+    CellStreamReader()
+    :
+    _data(nullptr),
+    _size(0),
+    _header()
+    {
+    }
+
+    CellStreamReader(const CellStreamReader&) = delete;
+
+    // checks the magic at the start of the file, so cell streams can be told apart from videos
+    static bool is_cell_stream(const char* filename);
+
+    std::optional<std::string> open(const char* filename);
+
+    size_t width() const
+    {
+        return _header.width;
+    }
+
+    size_t height() const
+    {
+        return _header.height;
+    }
+
+    size_t levels() const
+    {
+        return _header.levels;
+    }
+
+    size_t frame_count() const
+    {
+        return _header.frame_count;
+    }
+
+    size_t file_size() const
+    {
+        return _size;
+    }
+
+    double framerate() const
+    {
+        return _header.frame_rate_den ? (double)_header.frame_rate_num / _header.frame_rate_den : 0.0;
+    }
+
+    std::chrono::nanoseconds pts(size_t frame) const
+    {
+        return std::chrono::nanoseconds(index_entry(frame).pts_ns);
+    }
+
+    bool is_keyframe(size_t frame) const
+    {
+        return index_entry(frame).flags & CELL_STREAM_KEYFRAME;
+    }
+
+    // decodes a frame on top of indices, which must hold the previous frame unless this one is a keyframe
+    // returns false if the frame's data is corrupt
+    bool apply_frame(size_t frame, ImageBuffer<uint8_t>& indices) const;
+
+    // random access: decodes forward from the closest keyframe at or before the frame
+    bool decode_frame(size_t frame, ImageBuffer<uint8_t>& indices) const;
+
+    ~CellStreamReader();
+};
+
+// Plays a cell stream file straight into the compositor
+class CellStreamSource : public FrameSource
+{
+private:
+    CellStreamReader _reader;
+    AlignedBuffer<uint8_t> _index_buffer;
+    ImageBuffer<uint8_t> _indices;
+    size_t _next_frame;
+    bool _looping;
+
+    // added to frame times, so timestamps keep counting up across loops
+    std::chrono::nanoseconds _loop_offset;
+
+public:
+    // width, height: size of the cell grid being played to
+    CellStreamSource(size_t width, size_t height);
+    CellStreamSource(const CellStreamSource&) = delete;
+
+    // levels: number of cursor shades being played with, which the file has to match
+    std::optional<std::string> open(const char* filename, size_t levels);
+
+    double framerate() const override
+    {
+        return _reader.framerate();
+    }
+
+    std::optional<std::string> seek(std::chrono::nanoseconds timestamp) override;
+
+    void set_looping(bool looping) override
+    {
+        _looping = looping;
+    }
+
+    bool next_frame(std::chrono::nanoseconds& pts) override;
+
+    const ImageBuffer<uint8_t>& frame_indices() override
+    {
+        return _indices;
+    }
+
+    const CellStreamReader& reader() const
+    {
+        return _reader;
+    }
+};
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cstring>
+
+#include "compositor.h"
+#include "trace.h"
+
+namespace
+{
+    // fills a run of cells which share a shade, writing each pixel row of the run in one sweep
+    // tile: the shade padded out to width x rows, stride: backbuffer pixels per row
+    template <size_t width>
+    void blit_run_fixed(uint32_t* destination, size_t stride, const uint32_t* tile, size_t, size_t cells, size_t rows)
+    {
+        for (size_t row = 0; row < rows; row++)
+        {
+            const uint32_t* source = tile + row * width;
+            uint32_t* out = destination + row * stride;
+
+            // a constant size, so the compiler unrolls it into a few vector moves
+            for (size_t cell = 0; cell < cells; cell++)
+            {
+                std::memcpy(out + cell * width, source, width * sizeof(uint32_t));
+            }
+        }
+    }
+
+    void blit_run_generic(uint32_t* destination, size_t stride, const uint32_t* tile, size_t width, size_t cells, size_t rows)
+    {
+        for (size_t row = 0; row < rows; row++)
+        {
+            const uint32_t* source = tile + row * width;
+            uint32_t* out = destination + row * stride;
+
+            for (size_t cell = 0; cell < cells; cell++)
+            {
+                std::memcpy(out + cell * width, source, width * sizeof(uint32_t));
+            }
+        }
+    }
+
+    // bands per thread when composing on a TaskPool, the spare ones go to threads which finish their decoding early
+    const size_t bands_per_task_thread = 2;
+
+    // cell widths of common cursor themes once cropped, picked from when the compositor is created
+    const struct
+    {
+        size_t width;
+        FrameCompositor::BlitRun blit;
+    }
+    fixed_blits[] = {
+        { 8, blit_run_fixed<8> },
+        { 10, blit_run_fixed<10> },
+        { 12, blit_run_fixed<12> },
+        { 14, blit_run_fixed<14> },
+        { 16, blit_run_fixed<16> },
+        { 18, blit_run_fixed<18> },
+        { 20, blit_run_fixed<20> },
+        { 24, blit_run_fixed<24> },
+        { 28, blit_run_fixed<28> },
+        { 32, blit_run_fixed<32> },
+        { 40, blit_run_fixed<40> },
+        { 48, blit_run_fixed<48> },
+        { 64, blit_run_fixed<64> }
+    };
+}
+
+FrameCompositor::FrameCompositor(const CursorPixel& cursors, RenderSink& sink, size_t compose_threads, bool specialised_blits)
+:
+FrameCompositor(cursors, sink, compose_threads, nullptr, specialised_blits)
+{
+}
+
+FrameCompositor::FrameCompositor(const CursorPixel& cursors, RenderSink& sink, TaskPool& task_pool, bool specialised_blits)
+:
+FrameCompositor(cursors, sink, 1, &task_pool, specialised_blits)
+{
+}
+
+FrameCompositor::FrameCompositor(const CursorPixel& cursors, RenderSink& sink, size_t compose_threads, TaskPool* task_pool, bool specialised_blits)
+:
+_cursors(cursors),
+_sink(sink),
+_tiles((cursors.count() + 1) * cursors.max_width() * cursors.max_height()),
+_blit_run(blit_run_generic),
+_specialised_blit(false),
+_dirty_cells(0),
+_compose_pool(compose_threads),
+_task_pool(task_pool),
+_band_regions(task_pool ? task_pool->size() * bands_per_task_thread : _compose_pool.size()),
+_band_dirty_cells(_band_regions.size())
+{
+    // every cell starts out blank, the same as the backbuffer
+    _previous_indices.assign(get_width() * get_height(), (uint8_t)_cursors.count());
+
+    // a frame has at most one region per row of cells, so composing never has to grow these
+    _dirty_regions.reserve(get_height());
+
+    for (std::vector<RectangleRegion>& regions : _band_regions)
+    {
+        regions.reserve(get_height());
+    }
+
+    // each shade padded out to a whole cell with transparent pixels, so a cell is always the same copy
+    // the tile after the last shade stays transparent for blank cells
+    for (size_t index = 0; index < _cursors.count(); index++)
+    {
+        const ImageBuffer<uint32_t>* image = _cursors.get_image(index);
+        uint32_t* tile = this->tile(index);
+
+        for (size_t y = 0; y < image->height; y++)
+        {
+            std::memcpy(tile + y * _cursors.max_width(), image->pixels + y * image->width, image->width * sizeof(uint32_t));
+        }
+    }
+
+    for (const auto& fixed_blit : fixed_blits)
+    {
+        if (specialised_blits && fixed_blit.width == _cursors.max_width())
+        {
+            _blit_run = fixed_blit.blit;
+            _specialised_blit = true;
+        }
+    }
+}
+
+size_t FrameCompositor::compose_rows(const ImageBuffer<uint8_t>& indices, size_t first_row, size_t end_row, std::vector<RectangleRegion>& regions)
+{
+    ImageBuffer<uint32_t>& backbuffer = _sink.backbuffer();
+    uint32_t* pixels = backbuffer.pixels;
+    const size_t stride = backbuffer.width;
+    const size_t cell_width = _cursors.max_width();
+    const size_t cell_height = _cursors.max_height();
+
+    // cells past this column hang off the right edge of the backbuffer
+    const size_t whole_columns = stride / cell_width;
+    size_t dirty_cells = 0;
+
+    for (size_t y = first_row; y < end_row; y++)
+    {
+        size_t screen_y = y * cell_height;
+        size_t clip_height = std::min(backbuffer.height - screen_y, cell_height);
+        const uint8_t* row_indices = indices.pixels + y * indices.width;
+        uint8_t* previous_indices = &_previous_indices[y * indices.width];
+
+        // span of cells which changed in this row
+        size_t dirty_start = indices.width;
+        size_t dirty_end = 0;
+
+        for (size_t x = 0; x < indices.width;)
+        {
+            uint8_t index = row_indices[x];
+
+            if (index == previous_indices[x])
+            {
+                x++;
+
+                continue;
+            }
+
+            // the run of changed cells which all take the same shade
+            size_t run_end = x + 1;
+
+            while (run_end < indices.width && row_indices[run_end] == index && previous_indices[run_end] != index)
+            {
+                run_end++;
+            }
+
+            std::memset(previous_indices + x, index, run_end - x);
+            dirty_cells += run_end - x;
+
+            if (x < dirty_start) dirty_start = x;
+            dirty_end = run_end;
+
+            const uint32_t* tile = this->tile(index);
+            size_t whole_end = clip_height == cell_height ? std::min(run_end, whole_columns) : x;
+
+            if (x < whole_end)
+            {
+                _blit_run(&pixels[screen_y * stride + x * cell_width], stride, tile, cell_width, whole_end - x, cell_height);
+            }
+
+            // cells cut off by the right or bottom edge
+            for (size_t edge_x = std::max(x, whole_end); edge_x < run_end; edge_x++)
+            {
+                size_t screen_x = edge_x * cell_width;
+                size_t clip_width = std::min(stride - screen_x, cell_width);
+
+                for (size_t curs_y = 0; curs_y < clip_height; curs_y++)
+                {
+                    std::memcpy(&pixels[(screen_y + curs_y) * stride + screen_x], tile + curs_y * cell_width, clip_width * sizeof(uint32_t));
+                }
+            }
+
+            x = run_end;
+        }
+
+        if (dirty_start < dirty_end)
+        {
+            size_t screen_x = dirty_start * cell_width;
+            size_t region_width = std::min(dirty_end * cell_width, stride) - screen_x;
+
+            add_dirty_region(regions, { screen_x, screen_y, region_width, clip_height });
+        }
+    }
+
+    return dirty_cells;
+}
+
+void FrameCompositor::add_dirty_region(std::vector<RectangleRegion>& regions, const RectangleRegion& region)
+{
+    // grow the previous region downwards when it spans the same columns
+    if (!regions.empty() &&
+    regions.back().x == region.x && regions.back().width == region.width &&
+    regions.back().y + regions.back().height == region.y)
+    {
+        regions.back().height += region.height;
+    }
+    else
+    {
+        regions.push_back(region);
+    }
+}
+
+void FrameCompositor::write_frame(const ImageBuffer<uint8_t>& indices)
+{
+    TRACE_SCOPE(Compose);
+
+    const size_t band_count = _band_regions.size();
+
+    // bands are whole rows of cells, so no two threads ever write the same backbuffer lines
+    auto compose_band = [&](size_t band) {
+        TRACE_SCOPE(ComposeBand);
+
+        size_t first_row = indices.height * band / band_count;
+        size_t end_row = indices.height * (band + 1) / band_count;
+
+        _band_regions[band].clear();
+        _band_dirty_cells[band] = compose_rows(indices, first_row, end_row, _band_regions[band]);
+    };
+
+    if (_task_pool)
+    {
+        TaskGroup bands;
+
+        for (size_t band = 0; band < band_count; band++)
+        {
+            _task_pool->submit(bands, compose_band, band);
+        }
+
+        _task_pool->wait(bands);
+    }
+    else
+    {
+        _compose_pool.run([&](size_t band) { compose_band(band); });
+    }
+
+    _dirty_cells = 0;
+
+    for (size_t band = 0; band < band_count; band++)
+    {
+        _dirty_cells += _band_dirty_cells[band];
+
+        for (const RectangleRegion& region : _band_regions[band])
+        {
+            add_dirty_region(_dirty_regions, region);
+        }
+    }
+}
+
+void FrameCompositor::present()
+{
+    TRACE_SCOPE(Present);
+
+    _sink.present(_dirty_regions);
+    _dirty_regions.clear();
+}
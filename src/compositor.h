@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "misc.h"
+#include "frame_renderer.h"
+#include "render_sink.h"
+#include "worker_pool.h"
+#include "task_pool.h"
+#include "aligned_buffer.h"
+#include "x11/cursor_pixel.h"
+
+// Draws planes of cursor indices into a sink's backbuffer, one cursor per cell
+class FrameCompositor : public FrameRenderer
+{
+public:
+    // copies the tile into a run of cells in the same row, rows pixel rows high
+    using BlitRun = void (*)(uint32_t* destination, size_t stride, const uint32_t* tile, size_t width, size_t cells, size_t rows);
+
+private:
+    const CursorPixel& _cursors;
+    RenderSink& _sink;
+
+    // every shade padded to a whole cell, followed by a transparent tile for blank cells
+    AlignedBuffer<uint32_t> _tiles;
+
+    // unrolled for the cell width when it is a common one, generic otherwise
+    BlitRun _blit_run;
+    bool _specialised_blit;
+
+    // cursor index each cell was last drawn with, so unchanged cells can be skipped
+    std::vector<uint8_t> _previous_indices;
+    std::vector<RectangleRegion> _dirty_regions;
+    size_t _dirty_cells;
+
+    // the cell grid is composited in horizontal bands, one per thread
+    // or, sharing a TaskPool, a few per thread as tasks for whichever thread is free
+    WorkerPool _compose_pool;
+    TaskPool* _task_pool;
+    std::vector<std::vector<RectangleRegion>> _band_regions;
+    std::vector<size_t> _band_dirty_cells;
+
+    // composites cell rows [first_row, end_row) and appends the regions that changed
+    // returns the number of cells which changed
+    size_t compose_rows(const ImageBuffer<uint8_t>& indices, size_t first_row, size_t end_row, std::vector<RectangleRegion>& regions);
+
+    static void add_dirty_region(std::vector<RectangleRegion>& regions, const RectangleRegion& region);
+
+    FrameCompositor(const CursorPixel& cursors, RenderSink& sink, size_t compose_threads, TaskPool* task_pool, bool specialised_blits);
+
+    const uint32_t* tile(size_t index) const
+    {
+        return _tiles.data() + std::min(index, _cursors.count()) * _cursors.max_width() * _cursors.max_height();
+    }
+
+    uint32_t* tile(size_t index)
+    {
+        return _tiles.data() + std::min(index, _cursors.count()) * _cursors.max_width() * _cursors.max_height();
+    }
+
+public:
+    // compose_threads: number of threads write_frame() splits the cell grid between
+    // specialised_blits: false copies cells with the generic kernel even for common widths, to compare them
+    // the sink's backbuffer must be blank
+    FrameCompositor(const CursorPixel& cursors, RenderSink& sink, size_t compose_threads = 1, bool specialised_blits = true);
+
+    // composes in tasks on a pool shared with other work, eg. decoding tiled videos, instead of threads of its own
+    FrameCompositor(const CursorPixel& cursors, RenderSink& sink, TaskPool& task_pool, bool specialised_blits = true);
+    FrameCompositor(const FrameCompositor&) = delete;
+
+    // only recomposes the cells whose cursor changed since the previous frame
+    void write_frame(const ImageBuffer<uint8_t>& indices) override;
+
+    // presents the regions touched since the last present()
+    void present() override;
+
+    size_t dirty_cells() const override
+    {
+        return _dirty_cells;
+    }
+
+    uint64_t bytes_sent() const override
+    {
+        return _sink.bytes_sent();
+    }
+
+    // whether cells are copied by a kernel unrolled for the cell width
+    bool specialised_blit() const
+    {
+        return _specialised_blit;
+    }
+
+    // threads used by write_frame(), each owning one band of cell rows
+    // a single unused one when composing on a TaskPool
+    const WorkerPool& compose_pool() const
+    {
+        return _compose_pool;
+    }
+
+    // size of the cell grid covering the backbuffer
+    size_t get_width() const override
+    {
+        return round_up_div(_sink.backbuffer().width, _cursors.max_width());
+    }
+
+    size_t get_height() const override
+    {
+        return round_up_div(_sink.backbuffer().height, _cursors.max_height());
+    }
+};
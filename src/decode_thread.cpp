@@ -0,0 +1,113 @@
+#include "decode_thread.h"
+
+size_t DecodeThread::slot_size(size_t width, size_t height)
+{
+    return round_up_div(width * height, buffer_alignment) * buffer_alignment;
+}
+
+std::vector<DecodedFrame> DecodeThread::create_slots(uint8_t* pixels, size_t width, size_t height, size_t depth)
+{
+    std::vector<DecodedFrame> slots;
+
+    slots.reserve(depth);
+
+    for (size_t i = 0; i < depth; i++)
+    {
+        slots.push_back({ ImageBuffer<uint8_t>(pixels + i * slot_size(width, height), width, height), std::chrono::nanoseconds(0) });
+    }
+
+    return slots;
+}
+
+DecodeThread::DecodeThread(VideoPlayer& video_player, size_t width, size_t height, size_t depth)
+:
+_video_player(video_player),
+_pixels(slot_size(width, height) * depth),
+_queue(create_slots(_pixels.data(), width, height, depth)),
+_stop(false),
+_finished(false),
+_frames_consumed(0),
+_underruns(0),
+_total_occupancy(0),
+_last_occupancy(0)
+{
+}
+
+void DecodeThread::start()
+{
+    _thread = std::thread(&DecodeThread::run, this);
+}
+
+void DecodeThread::run()
+{
+    while (!_stop.load(std::memory_order_relaxed))
+    {
+        DecodedFrame* slot = nullptr;
+
+        _slot_freed.wait([&]() { return (slot = _queue.back()) || _stop.load(std::memory_order_relaxed); });
+
+        if (!slot)
+        {
+            break;
+        }
+
+        if (!_video_player.get_next_frame(slot->image.pixels))
+        {
+            break;
+        }
+
+        slot->pts = _video_player.frame_time();
+
+        _queue.push();
+        _frame_pushed.notify();
+    }
+
+    _finished.store(true, std::memory_order_release);
+    _frame_pushed.notify();
+}
+
+const DecodedFrame* DecodeThread::next_frame()
+{
+    _last_occupancy = _queue.size();
+
+    DecodedFrame* frame = _queue.front();
+
+    if (!frame)
+    {
+        // waiting for the very first frame is startup, not an underrun
+        if (_frames_consumed != 0 && !_finished.load(std::memory_order_acquire))
+        {
+            _underruns++;
+        }
+
+        // check the queue again after seeing the flag, the last frame may have been pushed just before it
+        _frame_pushed.wait([&]() { return (frame = _queue.front()) || _finished.load(std::memory_order_acquire); });
+
+        if (!frame && !(frame = _queue.front()))
+        {
+            return nullptr;
+        }
+    }
+
+    _frames_consumed++;
+    _total_occupancy += _last_occupancy;
+
+    return frame;
+}
+
+void DecodeThread::release_frame()
+{
+    _queue.pop();
+    _slot_freed.notify();
+}
+
+DecodeThread::~DecodeThread()
+{
+    _stop.store(true, std::memory_order_relaxed);
+    _slot_freed.notify();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
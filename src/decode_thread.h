@@ -0,0 +1,88 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "misc.h"
+#include "aligned_buffer.h"
+#include "spsc_queue.h"
+#include "ring_signal.h"
+#include "video_player.h"
+
+struct DecodedFrame
+{
+    ImageBuffer<uint8_t> image;
+
+    // presentation time relative to the start of the stream
+    std::chrono::nanoseconds pts;
+};
+
+// Decodes and scales frames ahead of playback on its own thread,
+// so decoder hiccups are absorbed by the ring instead of the frame budget
+class DecodeThread
+{
+private:
+    VideoPlayer& _video_player;
+    AlignedBuffer<uint8_t> _pixels;
+    SpscQueue<DecodedFrame> _queue;
+    std::thread _thread;
+    std::atomic<bool> _stop;
+    std::atomic<bool> _finished;
+
+    // the decoder waits for a free slot, the render loop for a decoded frame
+    RingSignal _slot_freed;
+    RingSignal _frame_pushed;
+
+    // consumer side statistics
+    size_t _frames_consumed;
+    size_t _underruns;
+    size_t _total_occupancy;
+    size_t _last_occupancy;
+
+    // each slot starts on its own cache line
+    static size_t slot_size(size_t width, size_t height);
+    static std::vector<DecodedFrame> create_slots(uint8_t* pixels, size_t width, size_t height, size_t depth);
+
+    void run();
+
+public:
+    // depth: number of frames which can be decoded ahead
+    DecodeThread(VideoPlayer& video_player, size_t width, size_t height, size_t depth);
+    DecodeThread(const DecodeThread&) = delete;
+
+    void start();
+
+    // waits for the next decoded frame
+    // returns null once the video has ended
+    const DecodedFrame* next_frame();
+
+    // hands the frame returned by next_frame() back to the decoder
+    void release_frame();
+
+    size_t depth() const
+    {
+        return _queue.capacity();
+    }
+
+    // times the render loop had to wait on the decoder
+    size_t underruns() const
+    {
+        return _underruns;
+    }
+
+    // frames which were ready when the last frame was taken
+    size_t occupancy() const
+    {
+        return _last_occupancy;
+    }
+
+    double average_occupancy() const
+    {
+        return _frames_consumed ? (double)_total_occupancy / _frames_consumed : 0.0;
+    }
+
+    ~DecodeThread();
+};
@@ -0,0 +1,180 @@
+#include <cstdint>
+#include <cerrno>
+
+#include "frame_pool.h"
+#include "aligned_buffer.h"
+#include "misc.h"
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+    #include <libavutil/pixdesc.h>
+}
+
+namespace
+{
+#if LIBAVUTIL_VERSION_MAJOR < 57
+    using buffer_size_t = int;
+#else
+    using buffer_size_t = size_t;
+#endif
+
+    // decoders read and write a little past the end of a plane with SIMD, libav's own pools pad the same way
+    const size_t plane_padding = 16 + buffer_alignment - 1;
+
+    void free_plane(void* mapped_bytes, uint8_t* data)
+    {
+        aligned_free(data, (size_t)(uintptr_t)mapped_bytes);
+    }
+}
+
+DecoderFramePool::DecoderFramePool()
+:
+_pools(),
+_linesizes(),
+_format(-1),
+_width(0),
+_height(0),
+_allocations(0)
+{
+}
+
+void DecoderFramePool::attach(AVCodecContext* context)
+{
+    context->opaque = this;
+    context->get_buffer2 = [](AVCodecContext* context, AVFrame* frame, int flags) {
+        return static_cast<DecoderFramePool*>(context->opaque)->get_buffer(context, frame, flags);
+    };
+}
+
+int DecoderFramePool::get_buffer(AVCodecContext* context, AVFrame* frame, int flags)
+{
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+
+    // codecs without direct rendering, hardware frames and palettes have to use libav's allocator
+    if (!(context->codec->capabilities & AV_CODEC_CAP_DR1) || !descriptor || (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+    {
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (frame->format != _format || frame->width != _width || frame->height != _height)
+    {
+        if (!reset(context, frame))
+        {
+            return avcodec_default_get_buffer2(context, frame, flags);
+        }
+    }
+
+    for (int plane = 0; plane < 4 && _pools[plane]; plane++)
+    {
+        frame->buf[plane] = av_buffer_pool_get(_pools[plane]);
+
+        if (!frame->buf[plane])
+        {
+            av_frame_unref(frame);
+
+            return AVERROR(ENOMEM);
+        }
+
+        frame->data[plane] = frame->buf[plane]->data;
+        frame->linesize[plane] = _linesizes[plane];
+    }
+
+    frame->extended_data = frame->data;
+
+    return 0;
+}
+
+bool DecoderFramePool::reset(AVCodecContext* context, const AVFrame* frame)
+{
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    int width = frame->width;
+    int height = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int linesizes[4];
+
+    // the codec's own padding, eg. to whole macroblocks
+    avcodec_align_dimensions2(context, &width, &height, linesize_align);
+
+    if (av_image_fill_linesizes(linesizes, format, width) < 0)
+    {
+        return false;
+    }
+
+    // a cache line covers every linesize_align, so rows start aligned too
+    ptrdiff_t aligned_linesizes[4];
+
+    for (int plane = 0; plane < 4; plane++)
+    {
+        linesizes[plane] = (int)(round_up_div((size_t)linesizes[plane], buffer_alignment) * buffer_alignment);
+        aligned_linesizes[plane] = linesizes[plane];
+    }
+
+    size_t plane_sizes[4];
+
+    if (av_image_fill_plane_sizes(plane_sizes, format, height, aligned_linesizes) < 0)
+    {
+        return false;
+    }
+
+    // frames still out with the decoder keep the old pools alive until they are released
+    release_pools();
+
+    for (int plane = 0; plane < 4 && plane_sizes[plane]; plane++)
+    {
+        _pools[plane] = av_buffer_pool_init2(plane_sizes[plane] + plane_padding, this, [](void* opaque, buffer_size_t size) -> AVBufferRef* {
+            size_t mapped_bytes = 0;
+            bool huge_pages = false;
+            uint8_t* data = (uint8_t*)aligned_allocate(size, mapped_bytes, huge_pages);
+
+            if (!data)
+            {
+                return nullptr;
+            }
+
+            AVBufferRef* buffer = av_buffer_create(data, size, free_plane, (void*)(uintptr_t)mapped_bytes, 0);
+
+            if (!buffer)
+            {
+                aligned_free(data, mapped_bytes);
+
+                return nullptr;
+            }
+
+            static_cast<DecoderFramePool*>(opaque)->_allocations.fetch_add(1, std::memory_order_relaxed);
+
+            return buffer;
+        }, nullptr);
+
+        _linesizes[plane] = linesizes[plane];
+
+        if (!_pools[plane])
+        {
+            release_pools();
+
+            return false;
+        }
+    }
+
+    _format = frame->format;
+    _width = frame->width;
+    _height = frame->height;
+
+    return true;
+}
+
+void DecoderFramePool::release_pools()
+{
+    for (AVBufferPool*& pool : _pools)
+    {
+        av_buffer_pool_uninit(&pool);
+    }
+
+    _format = -1;
+}
+
+DecoderFramePool::~DecoderFramePool()
+{
+    release_pools();
+}
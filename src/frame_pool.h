@@ -0,0 +1,51 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+}
+
+// Gives the decoder its frame buffers from pools that last for the whole video, through get_buffer2.
+// Buffers come back to the pool when libav releases the frame, so once the ring and the decoder's
+// reference frames are filled decoding never allocates, and every plane starts on a 64 byte boundary.
+class DecoderFramePool
+{
+private:
+    // frame threads ask for buffers concurrently
+    std::mutex _mutex;
+
+    // one pool per plane, null for planes the format doesn't have
+    AVBufferPool* _pools[4];
+    int _linesizes[4];
+
+    // the frame layout the pools were made for, they're rebuilt if the stream changes size mid-way
+    int _format, _width, _height;
+
+    std::atomic<size_t> _allocations;
+
+    int get_buffer(AVCodecContext* context, AVFrame* frame, int flags);
+
+    // returns false if libav can't describe the layout
+    bool reset(AVCodecContext* context, const AVFrame* frame);
+
+    void release_pools();
+
+public:
+    DecoderFramePool();
+    DecoderFramePool(const DecoderFramePool&) = delete;
+
+    // makes the codec allocate frames from this pool, before it is opened
+    // the pool has to outlive the codec context
+    void attach(AVCodecContext* context);
+
+    // plane buffers created so far, stops going up once decoding reaches a steady state
+    size_t allocations() const
+    {
+        return _allocations.load(std::memory_order_relaxed);
+    }
+
+    ~DecoderFramePool();
+};
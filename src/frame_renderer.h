@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include "misc.h"
+
+enum class RenderBackend
+{
+    Image,       // composites pixels on the client and sends them with XPutImage or MIT-SHM
+    GlyphSet,    // uploads the shades to the server once as XRender glyphs and sends cell indices
+    PixmapTiles, // core protocol only, tiles server-side pixmaps of the shades into changed cells
+    Present      // composites like Image, then flips pixmaps at vblank through the Present extension
+};
+
+enum class MonitorLayout
+{
+    Pointer, // only the monitor under the mouse pointer
+    Span,    // one frame stretched across every monitor, laid out as they are on the desktop
+    Mirror   // every monitor shows the whole frame
+};
+
+// Turns planes of cursor indices into something on screen, one cursor per cell
+class FrameRenderer
+{
+public:
+    // takes a plane of cursor indices (see ShadeQuantizer)
+    virtual void write_frame(const ImageBuffer<uint8_t>& indices) = 0;
+
+    // shows everything written since the last present()
+    virtual void present() = 0;
+
+    // number of cells redrawn by the last write_frame()
+    virtual size_t dirty_cells() const = 0;
+
+    // size of the cell grid covering the screen
+    virtual size_t get_width() const = 0;
+    virtual size_t get_height() const = 0;
+
+    size_t cell_count() const
+    {
+        return get_width() * get_height();
+    }
+
+    // bytes sent to the X server so far, 0 when rendering into memory
+    virtual uint64_t bytes_sent() const = 0;
+
+    virtual ~FrameRenderer() = default;
+};
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <time.h>
+
+#include "frame_scheduler.h"
+#include "trace.h"
+
+FrameScheduler::FrameScheduler(double framerate, bool paced, bool allow_drops)
+:
+_paced(paced && framerate > 0.0),
+_allow_drops(allow_drops),
+_frame_duration(framerate > 0.0 ? (int64_t)(1e9 / framerate) : 0),
+_start_time(0),
+_deadline(0),
+_frames_presented(0),
+_frames_dropped(0),
+_last_jitter(0),
+_max_jitter(0),
+_jitter_sum(0.0),
+_jitter_square_sum(0.0)
+{
+}
+
+std::chrono::nanoseconds FrameScheduler::now()
+{
+    timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+bool FrameScheduler::begin_frame(std::chrono::nanoseconds pts)
+{
+    std::chrono::nanoseconds current_time = now();
+
+    if (!_first_pts)
+    {
+        _first_pts = pts;
+        _start_time = current_time;
+    }
+
+    _deadline = _start_time + (pts - *_first_pts);
+
+    // by the time this frame could be shown the next one is already due
+    if (_paced && _allow_drops && current_time > _deadline + _frame_duration)
+    {
+        _frames_dropped++;
+
+        return false;
+    }
+
+    return true;
+}
+
+void FrameScheduler::wait_for_deadline()
+{
+    if (!_paced) return;
+
+    TRACE_SCOPE(WaitForDeadline);
+
+    timespec deadline;
+
+    deadline.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(_deadline).count();
+    deadline.tv_nsec = (_deadline - std::chrono::seconds(deadline.tv_sec)).count();
+
+    // absolute, so time spent before this call and oversleeping don't accumulate
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR);
+}
+
+void FrameScheduler::end_frame()
+{
+    _frames_presented++;
+
+    if (!_paced) return;
+
+    _last_jitter = now() - _deadline;
+
+    if (_last_jitter > _max_jitter) _max_jitter = _last_jitter;
+
+    double jitter_ms = _last_jitter.count() / 1e6;
+
+    _jitter_sum += jitter_ms;
+    _jitter_square_sum += jitter_ms * jitter_ms;
+}
+
+double FrameScheduler::mean_jitter_ms() const
+{
+    return _frames_presented ? _jitter_sum / _frames_presented : 0.0;
+}
+
+double FrameScheduler::jitter_stddev_ms() const
+{
+    if (!_frames_presented) return 0.0;
+
+    double mean = mean_jitter_ms();
+
+    return std::sqrt(std::max(_jitter_square_sum / _frames_presented - mean * mean, 0.0));
+}
+
+double FrameScheduler::average_fps() const
+{
+    if (!_first_pts || !_frames_presented) return 0.0;
+
+    double seconds = (now() - _start_time).count() / 1e9;
+
+    return seconds > 0.0 ? _frames_presented / seconds : 0.0;
+}
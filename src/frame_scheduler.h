@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+// Paces playback by the decoded presentation timestamps against absolute
+// deadlines on the monotonic clock, so timing never drifts. When playback
+// falls behind, frames which are already late are dropped instead of
+// slowing the video down.
+class FrameScheduler
+{
+private:
+    bool _paced;
+    bool _allow_drops;
+    std::chrono::nanoseconds _frame_duration;
+
+    // monotonic time the first frame was due, and that frame's timestamp
+    std::chrono::nanoseconds _start_time;
+    std::optional<std::chrono::nanoseconds> _first_pts;
+    std::chrono::nanoseconds _deadline;
+
+    size_t _frames_presented;
+    size_t _frames_dropped;
+
+    // how late frames were presented compared to their deadline
+    std::chrono::nanoseconds _last_jitter;
+    std::chrono::nanoseconds _max_jitter;
+    double _jitter_sum;
+    double _jitter_square_sum;
+
+public:
+    // framerate: nominal rate of the video, used to decide when a frame is too late
+    // paced: false plays as fast as possible
+    // allow_drops: false presents every frame however late it is
+    FrameScheduler(double framerate, bool paced, bool allow_drops = true);
+
+    static std::chrono::nanoseconds now();
+
+    // call for every decoded frame
+    // returns false when the frame is already too late and should be skipped without composing it
+    bool begin_frame(std::chrono::nanoseconds pts);
+
+    // sleeps until the frame from begin_frame() is due, call right before presenting it
+    void wait_for_deadline();
+
+    // call once the frame has been presented
+    void end_frame();
+
+    size_t frames_presented() const
+    {
+        return _frames_presented;
+    }
+
+    size_t frames_dropped() const
+    {
+        return _frames_dropped;
+    }
+
+    std::chrono::nanoseconds last_jitter() const
+    {
+        return _last_jitter;
+    }
+
+    std::chrono::nanoseconds max_jitter() const
+    {
+        return _max_jitter;
+    }
+
+    double mean_jitter_ms() const;
+    double jitter_stddev_ms() const;
+
+    // presented frames per second since the first frame
+    double average_fps() const;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+#include "misc.h"
+
+// Produces the planes of cursor indices which are played back, one frame at a time
+class FrameSource
+{
+public:
+    // nominal rate of the frames, 0 when unknown
+    virtual double framerate() const = 0;
+
+    // advances to the next frame and gives its presentation time
+    // returns false once the source has ended
+    virtual bool next_frame(std::chrono::nanoseconds& pts) = 0;
+
+    // the next frame is the first one at or after the timestamp
+    // call before the first next_frame()
+    virtual std::optional<std::string> seek(std::chrono::nanoseconds timestamp) = 0;
+
+    // start again from the beginning once the end is reached, with timestamps carrying on from the last frame
+    // call before the first next_frame()
+    virtual void set_looping(bool looping) = 0;
+
+    // the cursor indices of the frame from next_frame()
+    // only called for frames which are shown, so sources can skip work for dropped ones
+    virtual const ImageBuffer<uint8_t>& frame_indices() = 0;
+
+    virtual ~FrameSource() = default;
+};
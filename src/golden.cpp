@@ -0,0 +1,115 @@
+#include <fstream>
+#include <sstream>
+#include <cinttypes>
+#include <cstdio>
+
+#include "golden.h"
+
+GoldenFrames::GoldenFrames(Mode mode, std::string filename, size_t width, size_t height)
+:
+_mode(mode),
+_filename(std::move(filename)),
+_width(width),
+_height(height),
+_frame_index(0),
+_mismatches(0)
+{
+}
+
+uint64_t GoldenFrames::hash(const ImageBuffer<uint32_t>& frame)
+{
+    // FNV-1a, a pixel at a time rather than a byte at a time as frames are large
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (size_t i = 0; i < frame.width * frame.height; i++)
+    {
+        hash = (hash ^ frame.pixels[i]) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+std::optional<std::string> GoldenFrames::load()
+{
+    std::ifstream file(_filename);
+
+    if (!file)
+    {
+        return "could not open " + _filename;
+    }
+
+    std::string line;
+
+    // the first line records the size the hashes were made at
+    if (!std::getline(file, line))
+    {
+        return _filename + " is empty";
+    }
+
+    size_t width = 0, height = 0;
+
+    if (std::sscanf(line.c_str(), "# cursor-video golden frames %zux%zu", &width, &height) != 2)
+    {
+        return _filename + " is not a golden frame file";
+    }
+
+    if (width != _width || height != _height)
+    {
+        std::ostringstream err;
+
+        err << _filename << " was recorded at " << width << "x" << height << " but playback is " << _width << "x" << _height;
+
+        return err.str();
+    }
+
+    while (std::getline(file, line))
+    {
+        uint64_t hash = 0;
+
+        if (std::sscanf(line.c_str(), "%" SCNx64, &hash) == 1)
+        {
+            _hashes.push_back(hash);
+        }
+    }
+
+    return {};
+}
+
+std::optional<std::string> GoldenFrames::save() const
+{
+    FILE* file = std::fopen(_filename.c_str(), "w");
+
+    if (!file)
+    {
+        return "could not write " + _filename;
+    }
+
+    std::fprintf(file, "# cursor-video golden frames %zux%zu\n", _width, _height);
+
+    for (uint64_t hash : _hashes)
+    {
+        std::fprintf(file, "%016" PRIx64 "\n", hash);
+    }
+
+    std::fclose(file);
+
+    return {};
+}
+
+void GoldenFrames::add_frame(const ImageBuffer<uint32_t>& frame)
+{
+    uint64_t frame_hash = hash(frame);
+
+    if (_mode == Mode::Record)
+    {
+        _hashes.push_back(frame_hash);
+    }
+    else if (_frame_index >= _hashes.size() || _hashes[_frame_index] != frame_hash)
+    {
+        if (!_first_mismatch) _first_mismatch = _frame_index;
+
+        _mismatches++;
+    }
+
+    _frame_index++;
+}
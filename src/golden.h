@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <cstdint>
+
+#include "misc.h"
+
+// Hashes every composited frame and either records the hashes to a file
+// or checks them against a previously recorded one, to catch rendering
+// regressions when changing the hot path.
+// The hashes depend on the cursor theme, so record and check on the same setup.
+class GoldenFrames
+{
+public:
+    enum class Mode
+    {
+        Record,
+        Check
+    };
+
+private:
+    Mode _mode;
+    std::string _filename;
+    size_t _width, _height;
+    std::vector<uint64_t> _hashes;
+    size_t _frame_index;
+    size_t _mismatches;
+    std::optional<size_t> _first_mismatch;
+
+public:
+    GoldenFrames(Mode mode, std::string filename, size_t width, size_t height);
+
+    // check mode: loads the recorded hashes
+    std::optional<std::string> load();
+
+    // record mode: writes the hashes of every frame seen so far
+    std::optional<std::string> save() const;
+
+    void add_frame(const ImageBuffer<uint32_t>& frame);
+
+    static uint64_t hash(const ImageBuffer<uint32_t>& frame);
+
+    Mode mode() const
+    {
+        return _mode;
+    }
+
+    size_t frames() const
+    {
+        return _frame_index;
+    }
+
+    // frames which didn't match, including ones past the end of the recording
+    size_t mismatches() const
+    {
+        return _mismatches;
+    }
+
+    std::optional<size_t> first_mismatch() const
+    {
+        return _first_mismatch;
+    }
+
+    // the recording has frames which weren't played
+    bool missing_frames() const
+    {
+        return _mode == Mode::Check && _frame_index < _hashes.size();
+    }
+};
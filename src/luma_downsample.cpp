@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <functional>
+
+#include "luma_downsample.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <emmintrin.h>
+
+    #define LUMA_DOWNSAMPLE_SSE2 1
+#endif
+
+namespace
+{
+    // 257 * 255 is the most a 16 bit sum can hold
+    const size_t max_rows_per_sum = 257;
+
+    // adds one row of the source to the column sums, this is the part that touches every source pixel
+    // the caller makes sure no more than 257 rows go into one sum, so they fit in 16 bits
+    void accumulate_row(const uint8_t* row, uint16_t* sums, size_t width)
+    {
+        size_t x = 0;
+
+#ifdef LUMA_DOWNSAMPLE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i* out = (__m128i*)(sums + x);
+
+            _mm_storeu_si128(out + 0, _mm_add_epi16(_mm_loadu_si128(out + 0), _mm_unpacklo_epi8(pixels, zero)));
+            _mm_storeu_si128(out + 1, _mm_add_epi16(_mm_loadu_si128(out + 1), _mm_unpackhi_epi8(pixels, zero)));
+        }
+#endif
+
+        for (; x < width; x++)
+        {
+            sums[x] += row[x];
+        }
+    }
+
+    // averages the column sums over each output pixel's box
+    template <typename Sum>
+    void average_row(const Sum* sums, const uint32_t* x_bounds, const float* x_scales, float row_scale, const uint8_t* range_table, uint8_t* output, size_t width)
+    {
+        for (size_t x = 0; x < width; x++)
+        {
+            uint32_t sum = 0;
+
+            for (uint32_t source_x = x_bounds[x]; source_x < x_bounds[x + 1]; source_x++)
+            {
+                sum += sums[source_x];
+            }
+
+            // a 32 bit sum holds boxes of up to 16 million pixels, far past any video
+            output[x] = range_table[(uint32_t)((float)sum * x_scales[x] * row_scale + 0.5f)];
+        }
+    }
+
+    std::vector<uint32_t> box_bounds(size_t source_size, size_t size)
+    {
+        std::vector<uint32_t> bounds(size + 1);
+
+        for (size_t i = 0; i <= size; i++)
+        {
+            bounds[i] = (uint32_t)(i * source_size / size);
+        }
+
+        return bounds;
+    }
+}
+
+LumaDownsampler::LumaDownsampler(size_t source_width, size_t source_height, size_t width, size_t height, bool limited_range)
+:
+_source_width(source_width),
+_source_height(source_height),
+_width(width),
+_height(height),
+_limited_range(limited_range),
+_x_bounds(box_bounds(source_width, width)),
+_y_bounds(box_bounds(source_height, height)),
+_x_scales(width),
+_column_sums(source_width),
+_wide_sums()
+{
+    for (size_t x = 0; x < width; x++)
+    {
+        _x_scales[x] = 1.0f / (float)(_x_bounds[x + 1] - _x_bounds[x]);
+    }
+
+    for (int luma = 0; luma < 256; luma++)
+    {
+        // the same expansion swscale does when converting to GRAY8
+        _range_table[luma] = limited_range ? (uint8_t)std::clamp(((luma - 16) * 255 + 109) / 219, 0, 255) : (uint8_t)luma;
+    }
+}
+
+void LumaDownsampler::downsample(const uint8_t* luma, size_t stride, uint8_t* output)
+{
+    for (size_t y = 0; y < _height; y++)
+    {
+        size_t rows = _y_bounds[y + 1] - _y_bounds[y];
+        bool wide = rows > max_rows_per_sum;
+
+        if (wide)
+        {
+            _wide_sums.assign(_source_width, 0);
+        }
+
+        for (size_t first_row = _y_bounds[y]; first_row < _y_bounds[y + 1]; first_row += max_rows_per_sum)
+        {
+            size_t last_row = std::min(first_row + max_rows_per_sum, (size_t)_y_bounds[y + 1]);
+
+            std::fill(_column_sums.begin(), _column_sums.end(), 0);
+
+            for (size_t source_y = first_row; source_y < last_row; source_y++)
+            {
+                accumulate_row(luma + source_y * stride, _column_sums.data(), _source_width);
+            }
+
+            if (wide)
+            {
+                std::transform(_wide_sums.begin(), _wide_sums.end(), _column_sums.begin(), _wide_sums.begin(), std::plus<uint32_t>());
+            }
+        }
+
+        uint8_t* output_row = output + y * _width;
+        float row_scale = 1.0f / (float)rows;
+
+        if (wide)
+        {
+            average_row(_wide_sums.data(), _x_bounds.data(), _x_scales.data(), row_scale, _range_table, output_row, _width);
+        }
+        else
+        {
+            average_row(_column_sums.data(), _x_bounds.data(), _x_scales.data(), row_scale, _range_table, output_row, _width);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Area-averages an 8 bit luma plane straight down to the cell grid.
+// YUV video already carries the grey image in its Y plane, so this skips the colour conversion swscale would do.
+// Only shrinks: every output pixel covers at least one source pixel.
+class LumaDownsampler
+{
+private:
+    size_t _source_width, _source_height;
+    size_t _width, _height;
+    bool _limited_range;
+
+    // source columns/rows [bounds[i], bounds[i + 1]) make up output column/row i
+    std::vector<uint32_t> _x_bounds;
+    std::vector<uint32_t> _y_bounds;
+
+    // 1 / the width of each output column's box, divisions would cost more than the rest of the horizontal pass
+    std::vector<float> _x_scales;
+
+    // sums of each source column over the rows of the output row being built
+    // 16 bits halves the memory traffic, boxes taller than that can hold are added up in _wide_sums
+    std::vector<uint16_t> _column_sums;
+    std::vector<uint32_t> _wide_sums;
+
+    // stretches limited range (16-235) luma to full range, or passes it through
+    uint8_t _range_table[256];
+
+public:
+    // limited_range: the luma uses the 16-235 "MPEG" range, as most YUV video does
+    LumaDownsampler(size_t source_width, size_t source_height, size_t width, size_t height, bool limited_range);
+
+    // luma: the top left of the plane, stride: bytes between its rows
+    // output: width * height bytes
+    void downsample(const uint8_t* luma, size_t stride, uint8_t* output);
+
+    bool matches(size_t source_width, size_t source_height, bool limited_range) const
+    {
+        return _source_width == source_width && _source_height == source_height && _limited_range == limited_range;
+    }
+};
@@ -3,77 +3,846 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <memory>
+#include <optional>
+#include <chrono>
+#include <cmath>
 
 #include "x11/state.h"
 #include "x11/cursor_window.h"
-#include "video_player.h"
+#include "x11/cursor_pixel.h"
+#include "x11/glyph_renderer.h"
+#include "x11/pixmap_renderer.h"
+#include "x11/present_window.h"
+#include "offscreen_sink.h"
+#include "compositor.h"
+#include "multi_monitor.h"
+#include "golden.h"
+#include "video_source.h"
+#include "tiled_source.h"
+#include "task_pool.h"
+#include "cell_stream.h"
+#include "offline_render.h"
+#include "frame_scheduler.h"
+#include "quality_governor.h"
+#include "options.h"
+#include "trace.h"
+#include "alloc_counter.h"
+
+namespace
+{
+    // the window and renderer drawing on one monitor
+    struct WindowRenderer
+    {
+        std::unique_ptr<RenderSink> sink;
+        std::unique_ptr<FrameRenderer> renderer;
+
+        // the image backend's compositor, for its per-thread statistics
+        FrameCompositor* compositor = nullptr;
+
+        // the image backend's window, for how long it waited on the server
+        CursorOverlayWindow* overlay_window = nullptr;
+
+        // the present backend's window, for when frames reached the screen
+        PresentWindow* present_window = nullptr;
+
+        const char* present_path = "";
+    };
+
+    // composes on the shared pool when there is one, otherwise on threads of its own
+    std::unique_ptr<FrameCompositor> create_compositor(const CursorPixel& cursors, RenderSink& sink, size_t compose_threads, TaskPool* task_pool)
+    {
+        if (task_pool)
+        {
+            return std::make_unique<FrameCompositor>(cursors, sink, *task_pool);
+        }
+
+        return std::make_unique<FrameCompositor>(cursors, sink, compose_threads);
+    }
+
+    // creates the window for x11's monitor and the renderer for the chosen backend
+    // task_pool: composes on it instead of compose_threads of its own when not null
+    int create_window_renderer(const Options& options, X11State& x11, const CursorPixel& cursors, size_t compose_threads, TaskPool* task_pool, WindowRenderer& window)
+    {
+        if (options.backend == RenderBackend::GlyphSet)
+        {
+            auto glyph_renderer = std::make_unique<GlyphSetRenderer>(x11, cursors);
+
+            int err = glyph_renderer->create_window();
+
+            if (err)
+            {
+                return err;
+            }
+
+            window.present_path = "XRender glyphs";
+            window.renderer = std::move(glyph_renderer);
+        }
+        else if (options.backend == RenderBackend::PixmapTiles)
+        {
+            auto pixmap_renderer = std::make_unique<PixmapTileRenderer>(x11, cursors);
+
+            int err = pixmap_renderer->create_window();
+
+            if (err)
+            {
+                return err;
+            }
+
+            window.present_path = "pixmap tiles";
+            window.renderer = std::move(pixmap_renderer);
+        }
+        else if (options.backend == RenderBackend::Present)
+        {
+            auto present_window = std::make_unique<PresentWindow>(x11);
+
+            int err = present_window->create_window();
+
+            if (err)
+            {
+                return err;
+            }
+
+            window.present_path = "Present extension";
+            window.present_window = present_window.get();
+            window.sink = std::move(present_window);
+
+            auto frame_compositor = create_compositor(cursors, *window.sink, compose_threads, task_pool);
+
+            window.compositor = frame_compositor.get();
+            window.renderer = std::move(frame_compositor);
+        }
+        else
+        {
+            auto overlay_window = std::make_unique<CursorOverlayWindow>(x11);
+
+            int err = overlay_window->create_window(options.use_shm, options.shm_buffers);
+
+            if (err)
+            {
+                return err;
+            }
+
+            if (overlay_window->using_shm()) window.present_path = overlay_window->using_huge_pages() ? "MIT-SHM, huge pages" : "MIT-SHM";
+            else window.present_path = overlay_window->using_huge_pages() ? "XPutImage, huge pages" : "XPutImage";
+            window.overlay_window = overlay_window.get();
+            window.sink = std::move(overlay_window);
+
+            auto frame_compositor = create_compositor(cursors, *window.sink, compose_threads, task_pool);
+
+            window.compositor = frame_compositor.get();
+            window.renderer = std::move(frame_compositor);
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    // converts the video into a cell stream file, no display is needed
+    int transcode(const Options& options, const CursorPixel& cursors)
+    {
+        size_t grid_width = options.grid_width ? options.grid_width : round_up_div(options.headless_width, cursors.max_width());
+        size_t grid_height = options.grid_height ? options.grid_height : round_up_div(options.headless_height, cursors.max_height());
+
+        VideoFrameSource source(cursors.count(), options.dither);
+
+        if (auto err = source.probe(options.video_filename, options.decoder))
+        {
+            std::cerr << "error: " << options.video_filename << ": " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        if (auto err = source.open(grid_width, grid_height, options.decoder, options.ring_depth))
+        {
+            std::cerr << "error: " << options.video_filename << ": " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        if (options.start_time.count())
+        {
+            if (auto err = source.seek(options.start_time))
+            {
+                std::cerr << "error: " << options.video_filename << ": " << *err << std::endl;
+
+                return EXIT_FAILURE;
+            }
+        }
+
+        AVRational frame_rate = source.video_player().frame_rate();
+        size_t keyframe_interval = options.keyframe_interval ? options.keyframe_interval : std::max((size_t)std::lround(source.framerate() * 2), (size_t)1);
+
+        CellStreamWriter writer(grid_width, grid_height, cursors.count(), frame_rate.num, frame_rate.den, keyframe_interval);
+
+        if (auto err = writer.open(options.transcode_filename))
+        {
+            std::cerr << "error: " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Transcoding to a " << grid_width << "x" << grid_height << " cell grid, a keyframe every " << keyframe_interval << " frames" << std::endl;
+
+        std::chrono::nanoseconds pts;
+
+        while (source.next_frame(pts))
+        {
+            if (auto err = writer.add_frame(source.frame_indices(), pts))
+            {
+                std::cerr << "error: " << options.transcode_filename << ": " << *err << std::endl;
+
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (auto err = writer.finish())
+        {
+            std::cerr << "error: " << options.transcode_filename << ": " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        double raw_bytes = (double)grid_width * grid_height * writer.frames();
+
+        std::printf("%zu frames, %llu bytes (%.1f bytes per frame, %.1f%% of the raw index planes)\n", writer.frames(),
+                    (unsigned long long)writer.bytes_written(), writer.frames() ? (double)writer.bytes_written() / writer.frames() : 0.0,
+                    raw_bytes ? 100.0 * writer.bytes_written() / raw_bytes : 0.0);
+
+        return EXIT_SUCCESS;
+    }
+
+    // encodes the composited frames into a video file, no display or pacing
+    int render(const Options& options, const CursorPixel& cursors, size_t compose_threads)
+    {
+        RenderOptions render_options;
+
+        render_options.filename = options.render_filename;
+        render_options.width = options.headless_width;
+        render_options.height = options.headless_height;
+        render_options.segments = options.render_segments;
+        render_options.encoder = options.encoder;
+
+        OfflineRenderer renderer(cursors, render_options);
+
+        if (auto err = renderer.open(options.video_filename, options.decoder, options.dither, options.start_time, compose_threads, options.ring_depth))
+        {
+            std::cerr << "error: " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        std::printf("Rendering to %s: %s, %zu segment%s\n", options.render_filename.c_str(), renderer.segment(0).encoder().description().c_str(),
+                    renderer.segment_count(), renderer.segment_count() == 1 ? "" : "s");
+
+        if (auto err = renderer.run())
+        {
+            std::cerr << "error: " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        double render_seconds = std::chrono::duration<double>(renderer.render_time()).count();
+        double video_seconds = std::chrono::duration<double>(renderer.video_time()).count();
+
+        std::printf("Rendered %zu frames (%.1fs of video) in %.2fs: %.1f fps, %.1fx realtime\n", renderer.frames(), video_seconds, render_seconds,
+                    renderer.frames() / render_seconds, video_seconds / render_seconds);
+
+        for (size_t i = 0; options.print_stats && i < renderer.segment_count(); i++)
+        {
+            const RenderSegment& segment = renderer.segment(i);
+
+            std::printf("segment %zu: from %.2fs, %zu frames, %zu merged\n", i, segment.start_time().count() / 1e9, segment.frames(), segment.frames_merged());
+        }
+
+        return EXIT_SUCCESS;
+    }
+}
 
 int main(int argc, const char* const argv[])
 {
-    if(argc < 2)
+    Options options;
+
+    if (auto err = parse_options(argc, argv, options))
     {
-        std::cout << "Please provide a filename to the video which you intend on playing" << std::endl;
+        std::cout << *err << std::endl;
+        print_usage(argv[0]);
 
         return EXIT_FAILURE;
     }
 
-    const char* video_filename = argv[1];
+    if (options.show_help)
+    {
+        print_usage(argv[0]);
 
-    X11State x11;
-    CursorOverlayWindow window(x11, {
+        return EXIT_SUCCESS;
+    }
+
+    const char* video_filename = options.video_filename;
+
+    size_t compose_threads = options.compose_threads ? options.compose_threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+    const CursorPixel::cursor_list cursor_shades = {
         CursorType::Pointer,
         CursorType::Hand,
         CursorType::DownArrow,
         CursorType::IBeam
+    };
+
+    if (!options.transcode_filename.empty())
+    {
+        CursorPixel cursors(cursor_shades, options.cursor_cache);
+
+        return transcode(options, cursors);
+    }
+
+    if (!options.render_filename.empty())
+    {
+        CursorPixel cursors(cursor_shades, options.cursor_cache);
+
+        return render(options, cursors, compose_threads);
+    }
+
+    auto startup_start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds cursor_load_time(0);
+
+    // loading the cursor theme and probing the container don't need the display, so they run on threads of their own while it's set up
+    std::future<std::unique_ptr<CursorPixel>> cursor_loader = std::async(std::launch::async, [&]() {
+        auto load_start = std::chrono::steady_clock::now();
+        auto loaded_cursors = std::make_unique<CursorPixel>(cursor_shades, options.cursor_cache);
+
+        cursor_load_time = std::chrono::steady_clock::now() - load_start;
+
+        return loaded_cursors;
     });
 
-    int err = window.create_window();
+    // several videos play in tiles, each decoded by tasks on the pool the frame is composed on
+    bool tiled = options.video_filenames.size() > 1;
+
+    // precompiled cell streams are played straight from the file, anything else goes through the decoder
+    bool cell_stream = !tiled && CellStreamReader::is_cell_stream(video_filename);
+    std::unique_ptr<VideoFrameSource> decoded_source;
 
-    if (err)
+    // declared after the source it probes, so an early return waits for the probe before freeing it
+    std::future<std::optional<std::string>> prober;
+
+    if (!cell_stream && !tiled)
     {
-        return err;
+        decoded_source = std::make_unique<VideoFrameSource>(cursor_shades.size(), options.dither);
+        prober = std::async(std::launch::async, [&options, video_filename, probed_source = decoded_source.get()]() {
+            return probed_source->probe(video_filename, options.decoder);
+        });
     }
 
-    VideoPlayer video_player;
+    // declared before the renderer and source, whose tasks it runs
+    std::unique_ptr<TaskPool> task_pool;
 
-    if (auto err = video_player.open_video(video_filename, window.get_width(), window.get_height()))
+    if (tiled)
     {
-        std::cerr << "error: " << video_filename << ": " << *err << std::endl;
+        task_pool = std::make_unique<TaskPool>(compose_threads);
+    }
 
-        return EXIT_FAILURE;
+    // declared before the sink and renderer so the display outlives the window
+    std::unique_ptr<X11State> x11;
+    std::unique_ptr<RenderSink> sink;
+    std::unique_ptr<FrameRenderer> renderer;
+
+    // the image backend's compositor, for its per-thread statistics
+    FrameCompositor* compositor = nullptr;
+
+    // set when presenting through a single image backend window, for its buffer waits
+    CursorOverlayWindow* overlay_window = nullptr;
+
+    // set when presenting through a single present backend window, for its latencies
+    PresentWindow* present_window = nullptr;
+
+    auto display_start = std::chrono::steady_clock::now();
+
+    if (!options.headless)
+    {
+        x11 = std::make_unique<X11State>();
     }
 
-    std::cout << "Mouse display resolution: " << window.get_width() << "x" << window.get_height()
-              << " (" << window.get_width() * window.get_height() << " pixels)" << std::endl;
+    std::chrono::nanoseconds display_time = std::chrono::steady_clock::now() - display_start;
+
+    auto cursor_wait_start = std::chrono::steady_clock::now();
+    std::unique_ptr<CursorPixel> loaded_cursors = cursor_loader.get();
+    const CursorPixel& cursors = *loaded_cursors;
+    std::chrono::nanoseconds cursor_wait = std::chrono::steady_clock::now() - cursor_wait_start;
 
-    uint8_t frame_buffer[window.get_width() * window.get_height()];
-    ImageBuffer<uint8_t> frame(frame_buffer, window.get_width(), window.get_height());
-    FrameCounter frame_counter(video_player.framerate());
+    auto windows_start = std::chrono::steady_clock::now();
 
-    while(true)
+    if (options.headless)
     {
-        frame_counter.begin_frame();
+        sink = std::make_unique<OffscreenSink>(options.headless_width, options.headless_height, options.dump_directory, options.dump_format);
+
+        auto frame_compositor = create_compositor(cursors, *sink, compose_threads, task_pool.get());
+
+        compositor = frame_compositor.get();
+        renderer = std::move(frame_compositor);
+    }
+    else if (options.monitors == MonitorLayout::Pointer)
+    {
+        WindowRenderer window;
+
+        int err = create_window_renderer(options, *x11, cursors, compose_threads, task_pool.get(), window);
+
+        if (err)
+        {
+            return err;
+        }
 
-        if (!video_player.get_next_frame(frame.pixels)) break;
+        std::cout << "Present path: " << window.present_path << std::endl;
 
-        window.write_frame(frame);
-        window.swap_buffers();
+        sink = std::move(window.sink);
+        renderer = std::move(window.renderer);
+        compositor = window.compositor;
+        overlay_window = window.overlay_window;
+        present_window = window.present_window;
+    }
+    else
+    {
+        const std::vector<RectangleRegion>& monitors = x11->monitors;
+        auto multi_renderer = std::make_unique<MultiMonitorRenderer>(options.monitors, monitors.size(), cursors.max_width(), cursors.max_height(), (uint8_t)cursors.count());
 
-        frame_counter.end_frame();
+        // every monitor composes on its own thread already, so share the cores out between them
+        size_t monitor_compose_threads = std::max(compose_threads / std::max(monitors.size(), (size_t)1), (size_t)1);
 
-        if(frame_counter.frame_index() % 10 == 0)
+        for (const RectangleRegion& monitor : monitors)
         {
-            size_t dropped_frames = frame_counter.average_dropped_frames();
+            auto monitor_x11 = std::make_unique<X11State>(monitor);
+
+            WindowRenderer window;
+
+            int err = create_window_renderer(options, *monitor_x11, cursors, monitor_compose_threads, nullptr, window);
 
-            if (dropped_frames > 1)
+            if (err)
             {
-                std::cout << dropped_frames << " dropped frames" << std::endl;
+                return err;
             }
-            else if (dropped_frames != 0)
+
+            std::printf("Monitor %zu: x: %zu, y: %zu, width: %zu, height: %zu, present path: %s\n", multi_renderer->monitor_count(),
+                        monitor.x, monitor.y, monitor.width, monitor.height, window.present_path);
+
+            multi_renderer->add_monitor(std::move(monitor_x11), std::move(window.sink), std::move(window.renderer));
+        }
+
+        if (multi_renderer->monitor_count() == 0)
+        {
+            std::cerr << "Could not find any monitors" << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        renderer = std::move(multi_renderer);
+    }
+
+    std::chrono::nanoseconds windows_time = std::chrono::steady_clock::now() - windows_start;
+
+    std::unique_ptr<FrameSource> source;
+    VideoFrameSource* video_source = nullptr;
+    TiledVideoSource* tiled_source = nullptr;
+    std::chrono::nanoseconds probe_wait(0);
+    std::chrono::nanoseconds decoder_time(0);
+
+    if (tiled)
+    {
+        auto decoder_start = std::chrono::steady_clock::now();
+
+        // the pool already keeps every core busy with one video per task, more decoder threads would only contend with it
+        DecoderOptions tile_decoder = options.decoder;
+
+        if (!tile_decoder.thread_count) tile_decoder.thread_count = 1;
+
+        auto tiles = std::make_unique<TiledVideoSource>(*task_pool, cursor_shades.size(), options.dither);
+
+        if (auto err = tiles->open(options.video_filenames, renderer->get_width(), renderer->get_height(), tile_decoder))
+        {
+            std::cerr << "error: " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        decoder_time = std::chrono::steady_clock::now() - decoder_start;
+
+        tiled_source = tiles.get();
+        source = std::move(tiles);
+    }
+    else if (cell_stream)
+    {
+        auto cell_source = std::make_unique<CellStreamSource>(renderer->get_width(), renderer->get_height());
+
+        if (auto err = cell_source->open(video_filename, cursors.count()))
+        {
+            std::cerr << "error: " << video_filename << ": " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        source = std::move(cell_source);
+    }
+    else
+    {
+        auto probe_wait_start = std::chrono::steady_clock::now();
+        std::optional<std::string> probe_error = prober.get();
+
+        probe_wait = std::chrono::steady_clock::now() - probe_wait_start;
+
+        if (probe_error)
+        {
+            std::cerr << "error: " << video_filename << ": " << *probe_error << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        auto decoder_start = std::chrono::steady_clock::now();
+
+        if (auto err = decoded_source->open(renderer->get_width(), renderer->get_height(), options.decoder, options.ring_depth))
+        {
+            std::cerr << "error: " << video_filename << ": " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        decoder_time = std::chrono::steady_clock::now() - decoder_start;
+
+        video_source = decoded_source.get();
+        source = std::move(decoded_source);
+    }
+
+    source->set_looping(options.loop);
+
+    if (options.start_time.count())
+    {
+        if (auto err = source->seek(options.start_time))
+        {
+            std::cerr << "error: " << video_filename << ": " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << "Mouse display resolution: " << renderer->get_width() << "x" << renderer->get_height()
+              << " (" << renderer->get_width() * renderer->get_height() << " pixels)" << std::endl;
+
+    if (video_source)
+    {
+        std::cout << "Input: " << video_source->video_player().input_description() << std::endl;
+        std::cout << "Decoder: " << video_source->video_player().decoder_threading() << std::endl;
+    }
+    else if (tiled_source)
+    {
+        std::cout << "Tiles: " << tiled_source->tile_count() << " videos decoded and composed on " << task_pool->size() << " threads" << std::endl;
+
+        for (size_t i = 0; i < tiled_source->tile_count(); i++)
+        {
+            const VideoPlayer& player = tiled_source->tile_player(i);
+
+            std::printf("Tile %zu: %s, %.2f fps, %s, decoder: %s\n", i, tiled_source->tile_filename(i), player.framerate(),
+                        player.input_description().c_str(), player.decoder_threading().c_str());
+        }
+    }
+    else
+    {
+        std::cout << "Decoder: none, precompiled cell stream" << std::endl;
+    }
+
+    if (options.verbose)
+    {
+        auto ms = [](std::chrono::nanoseconds time) { return time.count() / 1e6; };
+
+        // the cursors and the probe overlap the display, so the waits are what they added on top of it
+        std::printf("Startup: display %.1fms, windows %.1fms, cursors %.1fms %s (waited %.1fms)", ms(display_time), ms(windows_time), ms(cursor_load_time),
+                    cursors.from_cache() ? "from the atlas cache" : "from the theme", ms(cursor_wait));
+
+        if (video_source)
+        {
+            std::printf(", probe %.1fms (waited %.1fms), decoder %.1fms", ms(video_source->video_player().probe_time()), ms(probe_wait), ms(decoder_time));
+        }
+        else if (tiled_source)
+        {
+            std::printf(", opening the tiles %.1fms", ms(decoder_time));
+        }
+
+        std::printf(", %.1fms in total\n", ms(std::chrono::steady_clock::now() - startup_start));
+    }
+
+    std::optional<GoldenFrames> golden;
+
+    if (options.golden_mode)
+    {
+        golden.emplace(*options.golden_mode, options.golden_filename, sink->backbuffer().width, sink->backbuffer().height);
+
+        if (*options.golden_mode == GoldenFrames::Mode::Check)
+        {
+            if (auto err = golden->load())
+            {
+                std::cerr << "error: " << *err << std::endl;
+
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    // golden checks need every frame, so never drop any while recording or checking
+    FrameScheduler scheduler(source->framerate(), !options.unpaced, !golden);
+
+    // only worth adapting when frames have a deadline to miss, and never under golden checks, which need every frame as recorded
+    std::optional<QualityGovernor> governor;
+
+    if (!options.fixed_quality && !options.unpaced && !golden && source->framerate() > 0)
+    {
+        // cell streams come quantized, and video on the direct luma path never touches swscale
+        bool can_dither = video_source || tiled_source;
+        bool can_fast_scale = video_source ? video_source->video_player().uses_swscale() : tiled_source && tiled_source->uses_swscale();
+
+        governor.emplace(source->framerate(), options.dither, can_dither, can_fast_scale);
+    }
+
+    auto playback_start = std::chrono::steady_clock::now();
+    size_t frames_drawn = 0;
+    size_t total_dirty_cells = 0;
+    size_t reported_drops = 0;
+    uint64_t previous_bytes_sent = 0;
+
+#ifdef CURSOR_VIDEO_COUNT_ALLOCS
+    uint64_t first_frame_allocations = 0;
+    uint64_t first_frame_thread_allocations = 0;
+#endif
+
+    std::chrono::nanoseconds pts;
+
+    while(source->next_frame(pts))
+    {
+        // too late to be worth showing, skip straight to the next one
+        if (!scheduler.begin_frame(pts))
+        {
+            continue;
+        }
+
+        // the current quality level only shows some of the frames
+        if (governor && !governor->begin_frame())
+        {
+            continue;
+        }
+
+        auto work_start = std::chrono::steady_clock::now();
+
+        renderer->write_frame(source->frame_indices());
+
+        auto compose_end = std::chrono::steady_clock::now();
+
+        scheduler.wait_for_deadline();
+
+        auto present_start = std::chrono::steady_clock::now();
+
+        renderer->present();
+        scheduler.end_frame();
+
+        // the sleep until the deadline isn't work, leave it out of the load
+        if (governor && governor->end_frame((compose_end - work_start) + (std::chrono::steady_clock::now() - present_start), scheduler.frames_dropped()))
+        {
+            if (video_source)
+            {
+                video_source->set_dither(governor->level().dither);
+                video_source->set_fast_scaling(governor->level().fast_scaling);
+            }
+            else if (tiled_source)
             {
-                std::cout << dropped_frames << " dropped frame" << std::endl;
+                tiled_source->set_dither(governor->level().dither);
+                tiled_source->set_fast_scaling(governor->level().fast_scaling);
             }
+
+            std::printf("Quality: %s\n", governor->last_decision().c_str());
         }
+
+        if (golden)
+        {
+            golden->add_frame(sink->backbuffer());
+        }
+
+        frames_drawn++;
+        total_dirty_cells += renderer->dirty_cells();
+
+        if (frames_drawn == 1)
+        {
+            std::printf("Time to first frame: %.1fms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_start).count());
+
+            if (video_source) std::printf(" (%.1fms probing the input)", video_source->video_player().probe_time().count() / 1e6);
+
+            std::printf("\n");
+        }
+
+#ifdef CURSOR_VIDEO_COUNT_ALLOCS
+        // the first frame fills the decoder's pools and the rings, every frame after it should run without allocating
+        if (frames_drawn == 1)
+        {
+            first_frame_allocations = heap_allocations();
+            first_frame_thread_allocations = thread_heap_allocations();
+        }
+#endif
+
+        if (options.print_stats)
+        {
+            std::printf("frame %zu: %.1f%% dirty cells, ", frames_drawn - 1, 100.0 * renderer->dirty_cells() / renderer->cell_count());
+
+            if (video_source)
+            {
+                std::printf("%zu/%zu frames decoded ahead, ", video_source->decoder().occupancy(), video_source->decoder().depth());
+            }
+
+            if (compositor && !task_pool)
+            {
+                std::chrono::nanoseconds slowest_band(0);
+
+                for (size_t i = 0; i < compositor->compose_pool().size(); i++)
+                {
+                    slowest_band = std::max(slowest_band, compositor->compose_pool().last_time(i));
+                }
+
+                std::printf("compose %.3fms, ", slowest_band.count() / 1e6);
+            }
+
+            if (overlay_window && overlay_window->shm_buffer_count() > 1)
+            {
+                std::printf("waited %.3fms for a buffer, ", overlay_window->last_buffer_wait().count() / 1e6);
+            }
+
+            if (present_window)
+            {
+                std::printf("last frame took %.3fms to reach the screen, ", present_window->last_latency().count() / 1e6);
+            }
+
+            std::printf("sent %.1fKB, presented %+.3fms from deadline\n", (renderer->bytes_sent() - previous_bytes_sent) / 1024.0, scheduler.last_jitter().count() / 1e6);
+
+            previous_bytes_sent = renderer->bytes_sent();
+        }
+
+        if(frames_drawn % 10 == 0 && scheduler.frames_dropped() != reported_drops)
+        {
+            reported_drops = scheduler.frames_dropped();
+
+            std::cout << reported_drops << (reported_drops > 1 ? " dropped frames" : " dropped frame") << std::endl;
+        }
+    }
+
+    double playback_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - playback_start).count();
+
+    if ((options.print_stats || options.headless) && frames_drawn)
+    {
+        std::printf("%zu frames in %.2fs (%.1f fps)\n", frames_drawn, playback_seconds, frames_drawn / playback_seconds);
+    }
+
+    if (options.print_stats && frames_drawn)
+    {
+        std::printf("%zu frames dropped, presented %.3fms late on average (stddev %.3fms, worst %.3fms)\n", scheduler.frames_dropped(),
+                    scheduler.mean_jitter_ms(), scheduler.jitter_stddev_ms(), scheduler.max_jitter().count() / 1e6);
+        std::printf("average: %.1f%% dirty cells\n", 100.0 * total_dirty_cells / (renderer->cell_count() * frames_drawn));
+
+        if (governor)
+        {
+            std::printf("quality: changed %zu times, ended at %s\n", governor->changes(), governor->level().name);
+        }
+
+        if (video_source)
+        {
+            const DecodeThread& decoder = video_source->decoder();
+
+            std::printf("decoder: %.1f/%zu frames decoded ahead on average, %zu underruns, %zu loops, %zu keyframes indexed, %zu frame buffers allocated\n", decoder.average_occupancy(),
+                        decoder.depth(), decoder.underruns(), video_source->video_player().loop_count(), video_source->video_player().indexed_keyframes(),
+                        video_source->video_player().frame_buffer_allocations());
+        }
+
+        if (!options.headless)
+        {
+            std::printf("sent %.1fKB per frame to the X server\n", renderer->bytes_sent() / 1024.0 / frames_drawn);
+        }
+
+        if (overlay_window && overlay_window->shm_buffer_count() > 1)
+        {
+            std::printf("%zu MIT-SHM buffers, waited for one to be released %zu times (%.3fms in total)\n", overlay_window->shm_buffer_count(),
+                        overlay_window->buffer_waits(), overlay_window->buffer_wait_time().count() / 1e6);
+        }
+
+        if (present_window)
+        {
+            std::printf("present: %zu frames shown %.3fms after presenting on average (worst %.3fms), %zu skipped, %zu lost, waited for one of %zu pixmaps %zu times (%.3fms in total)\n",
+                        present_window->completed_frames(), present_window->average_latency().count() / 1e6, present_window->max_latency().count() / 1e6,
+                        present_window->skipped_frames(), present_window->lost_frames(), present_window->pixmap_count(), present_window->pixmap_waits(), present_window->pixmap_wait_time().count() / 1e6);
+        }
+
+        for (size_t i = 0; compositor && !task_pool && i < compositor->compose_pool().size(); i++)
+        {
+            std::printf("compose thread %zu: %.3fms per frame\n", i, compositor->compose_pool().average_time(i).count() / 1e6);
+        }
+
+        for (size_t i = 0; tiled_source && i < tiled_source->tile_count(); i++)
+        {
+            std::printf("tile %zu: %zu frames decoded, %zu loops\n", i, tiled_source->tile_frames_decoded(i), tiled_source->tile_player(i).loop_count());
+        }
+
+        for (size_t i = 0; task_pool && i < task_pool->size(); i++)
+        {
+            std::printf("pool thread %zu: %zu tasks, %zu stolen from other threads\n", i, task_pool->tasks_run(i), task_pool->tasks_stolen(i));
+        }
+    }
+
+#ifdef CURSOR_VIDEO_COUNT_ALLOCS
+    if (frames_drawn > 1)
+    {
+        uint64_t allocations = heap_allocations() - first_frame_allocations;
+
+        std::printf("heap allocations after the first frame: %llu on the render thread, %llu in the whole process (%.2f per frame)\n",
+                    (unsigned long long)(thread_heap_allocations() - first_frame_thread_allocations), (unsigned long long)allocations,
+                    (double)allocations / (frames_drawn - 1));
+    }
+#endif
+
+#ifdef CURSOR_VIDEO_TRACE
+    trace_print_summary(stdout);
+
+    if (!options.trace_filename.empty())
+    {
+        if (auto err = trace_write_chrome(options.trace_filename))
+        {
+            std::cerr << "error: " << *err << std::endl;
+        }
+        else
+        {
+            std::cout << "wrote trace to " << options.trace_filename << std::endl;
+        }
+    }
+#endif
+
+    if (golden && golden->mode() == GoldenFrames::Mode::Record)
+    {
+        if (auto err = golden->save())
+        {
+            std::cerr << "error: " << *err << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "recorded " << golden->frames() << " golden frames to " << options.golden_filename << std::endl;
+    }
+    else if (golden)
+    {
+        if (golden->mismatches() || golden->missing_frames())
+        {
+            std::cerr << "golden check failed: " << golden->mismatches() << " of " << golden->frames() << " frames differ";
+
+            if (golden->first_mismatch()) std::cerr << ", first at frame " << *golden->first_mismatch();
+            if (golden->missing_frames()) std::cerr << ", playback ended before the recording did";
+
+            std::cerr << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "golden check passed: " << golden->frames() << " frames match" << std::endl;
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstring>
+
+#include "multi_monitor.h"
+
+MultiMonitorRenderer::MultiMonitorRenderer(MonitorLayout layout, size_t monitor_count, size_t cell_width, size_t cell_height, uint8_t blank_index)
+:
+_layout(layout),
+_cell_width(cell_width),
+_cell_height(cell_height),
+_blank_index(blank_index),
+_pool(monitor_count),
+_width(0),
+_height(0),
+_dirty_cells(0)
+{
+    _monitors.reserve(monitor_count);
+}
+
+void MultiMonitorRenderer::add_monitor(std::unique_ptr<X11State> x11, std::unique_ptr<RenderSink> sink, std::unique_ptr<FrameRenderer> renderer)
+{
+    Monitor monitor;
+
+    monitor.x11 = std::move(x11);
+    monitor.sink = std::move(sink);
+    monitor.renderer = std::move(renderer);
+    monitor.cell_x = 0;
+    monitor.cell_y = 0;
+    monitor.indices.assign(monitor.renderer->cell_count(), _blank_index);
+
+    _monitors.push_back(std::move(monitor));
+
+    // the canvas starts at the top left of the leftmost and topmost monitors, so it moves as monitors are added
+    size_t left = SIZE_MAX, top = SIZE_MAX;
+
+    for (const Monitor& m : _monitors)
+    {
+        left = std::min(left, m.x11->monitor_region.x);
+        top = std::min(top, m.x11->monitor_region.y);
+    }
+
+    _width = _layout == MonitorLayout::Span ? 0 : SIZE_MAX;
+    _height = _layout == MonitorLayout::Span ? 0 : SIZE_MAX;
+
+    for (Monitor& m : _monitors)
+    {
+        if (_layout == MonitorLayout::Span)
+        {
+            m.cell_x = (m.x11->monitor_region.x - left) / _cell_width;
+            m.cell_y = (m.x11->monitor_region.y - top) / _cell_height;
+
+            _width = std::max(_width, m.cell_x + m.renderer->get_width());
+            _height = std::max(_height, m.cell_y + m.renderer->get_height());
+        }
+        else
+        {
+            _width = std::min(_width, m.renderer->get_width());
+            _height = std::min(_height, m.renderer->get_height());
+        }
+    }
+}
+
+void MultiMonitorRenderer::crop(Monitor& monitor, const ImageBuffer<uint8_t>& indices)
+{
+    size_t width = monitor.renderer->get_width();
+    size_t height = monitor.renderer->get_height();
+    size_t copy_width = monitor.cell_x < indices.width ? std::min(width, indices.width - monitor.cell_x) : 0;
+
+    for (size_t y = 0; y < height; y++)
+    {
+        uint8_t* row = monitor.indices.data() + y * width;
+        size_t source_y = monitor.cell_y + y;
+        size_t row_width = source_y < indices.height ? copy_width : 0;
+
+        if (row_width)
+        {
+            std::memcpy(row, indices.pixels + source_y * indices.width + monitor.cell_x, row_width);
+        }
+
+        std::memset(row + row_width, _blank_index, width - row_width);
+    }
+}
+
+void MultiMonitorRenderer::write_frame(const ImageBuffer<uint8_t>& indices)
+{
+    _pool.run([&](size_t i) {
+        if (i >= _monitors.size()) return;
+
+        Monitor& monitor = _monitors[i];
+
+        crop(monitor, indices);
+        monitor.renderer->write_frame(ImageBuffer<uint8_t>(monitor.indices.data(), monitor.renderer->get_width(), monitor.renderer->get_height()));
+    });
+
+    _dirty_cells = 0;
+
+    for (const Monitor& monitor : _monitors)
+    {
+        // mirrored monitors all show the same cells, so only count them once
+        _dirty_cells = _layout == MonitorLayout::Span ? _dirty_cells + monitor.renderer->dirty_cells() : std::max(_dirty_cells, monitor.renderer->dirty_cells());
+    }
+}
+
+void MultiMonitorRenderer::present()
+{
+    _pool.run([&](size_t i) {
+        if (i < _monitors.size()) _monitors[i].renderer->present();
+    });
+}
+
+uint64_t MultiMonitorRenderer::bytes_sent() const
+{
+    uint64_t bytes = 0;
+
+    for (const Monitor& monitor : _monitors)
+    {
+        bytes += monitor.renderer->bytes_sent();
+    }
+
+    return bytes;
+}
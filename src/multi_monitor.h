@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "misc.h"
+#include "frame_renderer.h"
+#include "render_sink.h"
+#include "worker_pool.h"
+#include "x11/state.h"
+
+// Draws one plane of cursor indices across several monitors.
+// Each monitor has its own display connection and renderer, and is composed and presented on its own thread,
+// so adding monitors doesn't add to the frame time as long as there are cores for them.
+class MultiMonitorRenderer : public FrameRenderer
+{
+private:
+    struct Monitor
+    {
+        // declared in this order so the renderer goes before its sink and the sink before its display
+        std::unique_ptr<X11State> x11;
+        std::unique_ptr<RenderSink> sink;
+        std::unique_ptr<FrameRenderer> renderer;
+
+        // where the monitor's cells start in the shared plane
+        size_t cell_x, cell_y;
+
+        // the monitor's part of the shared plane
+        std::vector<uint8_t> indices;
+    };
+
+    MonitorLayout _layout;
+    size_t _cell_width, _cell_height;
+    uint8_t _blank_index;
+    std::vector<Monitor> _monitors;
+    WorkerPool _pool;
+
+    size_t _width, _height;
+    size_t _dirty_cells;
+
+    // copies the monitor's cells out of the shared plane, blank where the plane doesn't reach
+    void crop(Monitor& monitor, const ImageBuffer<uint8_t>& indices);
+
+public:
+    // cell_width, cell_height: pixel size of a cell, which places the monitors on the shared grid
+    // blank_index: index of an empty cell, for parts of a monitor the frame doesn't cover
+    MultiMonitorRenderer(MonitorLayout layout, size_t monitor_count, size_t cell_width, size_t cell_height, uint8_t blank_index);
+    MultiMonitorRenderer(const MultiMonitorRenderer&) = delete;
+
+    // call once for each monitor before drawing
+    // sink: the image backend's window which renderer draws into, null for the other backends
+    void add_monitor(std::unique_ptr<X11State> x11, std::unique_ptr<RenderSink> sink, std::unique_ptr<FrameRenderer> renderer);
+
+    void write_frame(const ImageBuffer<uint8_t>& indices) override;
+    void present() override;
+
+    size_t dirty_cells() const override
+    {
+        return _dirty_cells;
+    }
+
+    // span: the grid covering every monitor, mirror: the grid fitting on the smallest monitor
+    size_t get_width() const override
+    {
+        return _width;
+    }
+
+    size_t get_height() const override
+    {
+        return _height;
+    }
+
+    uint64_t bytes_sent() const override;
+
+    size_t monitor_count() const
+    {
+        return _monitors.size();
+    }
+
+    // threads used by write_frame() and present(), one per monitor
+    const WorkerPool& pool() const
+    {
+        return _pool;
+    }
+};
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <cstring>
+
+#include "offline_render.h"
+
+namespace
+{
+    // frames composed ahead of the encoder
+    const size_t encode_ring_depth = 4;
+
+    // grid rate for videos which don't say
+    const AVRational fallback_frame_rate = { 30, 1 };
+
+    const AVRational nanoseconds_base = { 1, 1000000000 };
+}
+
+RenderSegment::RenderSegment(const CursorPixel& cursors, const RenderOptions& options, DitherMode dither)
+:
+_cursors(cursors),
+_source(cursors.count(), dither),
+_sink(options.width, options.height),
+_origin(0),
+_start(0),
+_end(0),
+_composed_all(false),
+_stop(false),
+_frames_composed(0),
+_frames_merged(0),
+_last_tick(-1),
+_encoded_all(false)
+{
+}
+
+std::optional<std::string> RenderSegment::probe(const char* video_filename, const DecoderOptions& decoder_options)
+{
+    return _source.probe(video_filename, decoder_options);
+}
+
+std::optional<std::string> RenderSegment::open(const DecoderOptions& decoder_options, size_t ring_depth, size_t compose_threads, std::chrono::nanoseconds origin,
+                                               std::chrono::nanoseconds start, std::chrono::nanoseconds end, const AVOutputFormat* format, AVRational frame_rate,
+                                               const EncoderOptions& encoder_options)
+{
+    _compositor.emplace(_cursors, _sink, compose_threads);
+
+    if (auto err = _source.open(_compositor->get_width(), _compositor->get_height(), decoder_options, ring_depth))
+    {
+        return err;
+    }
+
+    if (start.count())
+    {
+        if (auto err = _source.seek(start))
+        {
+            return err;
+        }
+    }
+
+    _origin = origin;
+    _start = start;
+    _end = end;
+
+    const ImageBuffer<uint32_t>& backbuffer = _sink.backbuffer();
+
+    if (auto err = _encoder.open(format, backbuffer.width, backbuffer.height, frame_rate, encoder_options))
+    {
+        return err;
+    }
+
+    std::vector<EncodeSlot> slots;
+
+    for (size_t i = 0; i < encode_ring_depth; i++)
+    {
+        AVFrame* frame = _encoder.allocate_frame();
+
+        if (!frame)
+        {
+            return "could not allocate frames to encode";
+        }
+
+        _frames.push_back(frame);
+        slots.push_back({ frame });
+    }
+
+    _encode_queue.emplace(std::move(slots));
+
+    return {};
+}
+
+void RenderSegment::start()
+{
+    _compose_thread = std::thread(&RenderSegment::compose, this);
+    _encode_thread = std::thread(&RenderSegment::encode, this);
+}
+
+void RenderSegment::compose()
+{
+    std::chrono::nanoseconds pts;
+
+    while (!_stop.load(std::memory_order_relaxed) && _source.next_frame(pts))
+    {
+        // the next segment starts here
+        if (_end.count() && pts >= _end)
+        {
+            break;
+        }
+
+        // the seek lands at or after the start, this only guards the segment before from getting its frames twice
+        if (pts < _start)
+        {
+            continue;
+        }
+
+        // the source's own timing, so variable frame rate video keeps it
+        int64_t tick = av_rescale_q_rnd((pts - _origin).count(), nanoseconds_base, _encoder.time_base(), AV_ROUND_DOWN);
+
+        // frames closer together than a tick of the output rate would share a timestamp, the first one stands for them
+        if (tick <= _last_tick)
+        {
+            _frames_merged++;
+
+            continue;
+        }
+
+        _compositor->write_frame(_source.frame_indices());
+        _compositor->present();
+
+        EncodeSlot* slot = nullptr;
+
+        _slot_freed.wait([&]() { return (slot = _encode_queue->back()) || _stop.load(std::memory_order_relaxed); });
+
+        if (!slot)
+        {
+            break;
+        }
+
+        if (auto err = _encoder.convert(_sink.backbuffer(), slot->frame))
+        {
+            fail(*err);
+
+            break;
+        }
+
+        slot->frame->pts = tick;
+        _last_tick = tick;
+        _frames_composed++;
+
+        _encode_queue->push();
+        _frame_pushed.notify();
+    }
+
+    _composed_all.store(true, std::memory_order_release);
+    _frame_pushed.notify();
+}
+
+void RenderSegment::encode()
+{
+    std::vector<AVPacket*> packets;
+
+    while (!_stop.load(std::memory_order_relaxed))
+    {
+        EncodeSlot* slot = nullptr;
+
+        _frame_pushed.wait([&]() {
+            return (slot = _encode_queue->front()) || _composed_all.load(std::memory_order_acquire) || _stop.load(std::memory_order_relaxed);
+        });
+
+        // check the queue again after seeing the flag, the last frame may have been pushed just before it
+        if (!slot && (_stop.load(std::memory_order_relaxed) || !(slot = _encode_queue->front())))
+        {
+            break;
+        }
+
+        // the encoder keeps its own reference to the frame's buffers, so the slot can be refilled straight away
+        std::optional<std::string> err = _encoder.encode(slot->frame, packets);
+
+        _encode_queue->pop();
+        _slot_freed.notify();
+
+        if (err)
+        {
+            fail(*err);
+
+            break;
+        }
+
+        deliver(packets);
+    }
+
+    if (!_stop.load(std::memory_order_relaxed))
+    {
+        if (auto err = _encoder.encode(nullptr, packets))
+        {
+            fail(*err);
+        }
+        else
+        {
+            deliver(packets);
+        }
+    }
+
+    for (AVPacket* packet : packets)
+    {
+        av_packet_free(&packet);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _encoded_all = true;
+    }
+
+    _condition.notify_all();
+}
+
+void RenderSegment::deliver(std::vector<AVPacket*>& packets)
+{
+    if (packets.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _packets.insert(_packets.end(), packets.begin(), packets.end());
+    }
+
+    packets.clear();
+    _condition.notify_all();
+}
+
+void RenderSegment::fail(const std::string& error)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_error) _error = error;
+    }
+
+    _stop.store(true, std::memory_order_relaxed);
+    _slot_freed.notify();
+    _frame_pushed.notify();
+}
+
+AVPacket* RenderSegment::next_packet()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _condition.wait(lock, [&]() { return !_packets.empty() || _encoded_all; });
+
+    if (_packets.empty())
+    {
+        return nullptr;
+    }
+
+    AVPacket* packet = _packets.front();
+
+    _packets.pop_front();
+
+    return packet;
+}
+
+std::optional<std::string> RenderSegment::error()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _error;
+}
+
+RenderSegment::~RenderSegment()
+{
+    _stop.store(true, std::memory_order_relaxed);
+    _slot_freed.notify();
+    _frame_pushed.notify();
+
+    if (_compose_thread.joinable()) _compose_thread.join();
+    if (_encode_thread.joinable()) _encode_thread.join();
+
+    for (AVPacket* packet : _packets)
+    {
+        av_packet_free(&packet);
+    }
+
+    for (AVFrame* frame : _frames)
+    {
+        av_frame_free(&frame);
+    }
+}
+
+OfflineRenderer::OfflineRenderer(const CursorPixel& cursors, const RenderOptions& options)
+:
+_cursors(cursors),
+_options(options),
+_frame_rate(fallback_frame_rate),
+_frames(0),
+_video_time(0),
+_render_time(0)
+{
+    // 4:2:0 encoders take colour for pairs of pixels
+    _options.width = std::max(_options.width & ~(size_t)1, (size_t)2);
+    _options.height = std::max(_options.height & ~(size_t)1, (size_t)2);
+}
+
+std::optional<std::string> OfflineRenderer::open(const char* video_filename, const DecoderOptions& decoder_options, DitherMode dither,
+                                                 std::chrono::nanoseconds start_time, size_t compose_threads, size_t ring_depth)
+{
+    if (auto err = _muxer.open(_options.filename))
+    {
+        return err;
+    }
+
+    _segments.push_back(std::make_unique<RenderSegment>(_cursors, _options, dither));
+
+    if (auto err = _segments[0]->probe(video_filename, decoder_options))
+    {
+        return std::string(video_filename) + ": " + *err;
+    }
+
+    const VideoPlayer& player = _segments[0]->video_player();
+    std::chrono::nanoseconds duration = player.duration();
+
+    if (player.frame_rate().num > 0 && player.frame_rate().den > 0)
+    {
+        _frame_rate = player.frame_rate();
+    }
+
+    // a video of unknown length can't be split
+    size_t segment_count = duration > start_time ? std::max(_options.segments, (size_t)1) : 1;
+
+    for (size_t i = 1; i < segment_count; i++)
+    {
+        _segments.push_back(std::make_unique<RenderSegment>(_cursors, _options, dither));
+
+        if (auto err = _segments[i]->probe(video_filename, decoder_options))
+        {
+            return std::string(video_filename) + ": " + *err;
+        }
+    }
+
+    // every segment runs its own decoder, compositor and encoder, so they share the cores out between them
+    size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t segment_threads = std::max(cores / segment_count, (size_t)1);
+
+    DecoderOptions segment_decoder = decoder_options;
+    EncoderOptions segment_encoder = _options.encoder;
+
+    if (!segment_decoder.thread_count) segment_decoder.thread_count = (int)segment_threads;
+    if (!segment_encoder.thread_count) segment_encoder.thread_count = (int)segment_threads;
+
+    // without B-frames decode timestamps never run behind presentation ones, so they can't go backwards where segments join
+    if (segment_count > 1) segment_encoder.b_frames = false;
+
+    // segments meet on a tick of the output rate, so a frame's tick always falls in the segment which decodes it
+    const AVRational tick = av_inv_q(_frame_rate);
+    const int64_t total_ticks = duration > start_time ? av_rescale_q_rnd((duration - start_time).count(), nanoseconds_base, tick, AV_ROUND_DOWN) : 0;
+
+    auto boundary = [&](size_t index) {
+        return start_time + std::chrono::nanoseconds(av_rescale_q_rnd(total_ticks * (int64_t)index / (int64_t)segment_count, tick, nanoseconds_base, AV_ROUND_UP));
+    };
+
+    for (size_t i = 0; i < segment_count; i++)
+    {
+        std::chrono::nanoseconds end = i + 1 < segment_count ? boundary(i + 1) : std::chrono::nanoseconds(0);
+
+        if (auto err = _segments[i]->open(segment_decoder, ring_depth, std::max(compose_threads / segment_count, (size_t)1), start_time, boundary(i), end,
+                                          _muxer.format(), _frame_rate, segment_encoder))
+        {
+            return std::string(video_filename) + ": " + *err;
+        }
+    }
+
+    // the container only keeps segment 0's global headers (eg. H.264's SPS and PPS), every other segment has to decode with them
+    const AVCodecContext* first = _segments[0]->encoder().codec_context();
+
+    for (size_t i = 1; i < segment_count && (first->flags & AV_CODEC_FLAG_GLOBAL_HEADER); i++)
+    {
+        const AVCodecContext* other = _segments[i]->encoder().codec_context();
+
+        if (other->extradata_size != first->extradata_size || (first->extradata_size && std::memcmp(other->extradata, first->extradata, first->extradata_size) != 0))
+        {
+            return std::string("the ") + first->codec->name + " encoder gave segment " + std::to_string(i) +
+                   " different stream headers from the first, so the segments can't be joined into " + _options.filename + ", try --segments 1";
+        }
+    }
+
+    return _muxer.write_header(_segments[0]->encoder());
+}
+
+std::optional<std::string> OfflineRenderer::run()
+{
+    auto render_start = std::chrono::steady_clock::now();
+
+    for (const auto& segment : _segments)
+    {
+        segment->start();
+    }
+
+    // every segment times its frames from the start of the render, so their packets follow on as they are
+    int64_t end_tick = 0;
+
+    for (const auto& segment : _segments)
+    {
+        while (AVPacket* packet = segment->next_packet())
+        {
+            std::optional<std::string> err = _muxer.write(packet, segment->encoder().time_base());
+
+            av_packet_free(&packet);
+
+            if (err)
+            {
+                return err;
+            }
+        }
+
+        if (auto err = segment->error())
+        {
+            return err;
+        }
+
+        end_tick = std::max(end_tick, segment->end_tick());
+        _frames += segment->frames();
+    }
+
+    _video_time = std::chrono::nanoseconds(av_rescale_q(end_tick, av_inv_q(_frame_rate), nanoseconds_base));
+
+    std::optional<std::string> err = _muxer.finish();
+
+    _render_time = std::chrono::steady_clock::now() - render_start;
+
+    return err;
+}
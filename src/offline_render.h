@@ -0,0 +1,214 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "video_source.h"
+#include "video_encoder.h"
+#include "offscreen_sink.h"
+#include "compositor.h"
+#include "spsc_queue.h"
+#include "ring_signal.h"
+#include "x11/cursor_pixel.h"
+
+struct RenderOptions
+{
+    std::string filename;
+
+    // output size in pixels, rounded down to even
+    size_t width = 1920;
+    size_t height = 1080;
+
+    // stretches of the video rendered at the same time, each with its own decoder, compositor and encoder
+    size_t segments = 1;
+
+    EncoderOptions encoder;
+};
+
+// One stretch of the video, decoded, composed and encoded as a pipeline: the decoder's own
+// thread feeds a compose thread, which converts each frame for the encoder and hands it to an
+// encode thread through a ring of frames. The packets wait for the muxer in a queue.
+class RenderSegment
+{
+private:
+    struct EncodeSlot
+    {
+        AVFrame* frame;
+    };
+
+    const CursorPixel& _cursors;
+    VideoFrameSource _source;
+    OffscreenSink _sink;
+
+    // made by open(), once the segment's share of threads is known
+    std::optional<FrameCompositor> _compositor;
+    VideoEncoder _encoder;
+
+    // [start, end) of the video, an end of 0 carries on until the video does
+    // frames are timed from origin, the start of the whole render
+    std::chrono::nanoseconds _origin;
+    std::chrono::nanoseconds _start;
+    std::chrono::nanoseconds _end;
+
+    std::vector<AVFrame*> _frames;
+    std::optional<SpscQueue<EncodeSlot>> _encode_queue;
+
+    // the compose thread waits for a free slot, the encode thread for a composed frame
+    RingSignal _slot_freed;
+    RingSignal _frame_pushed;
+
+    std::thread _compose_thread;
+    std::thread _encode_thread;
+    std::atomic<bool> _composed_all;
+    std::atomic<bool> _stop;
+
+    // compose thread only, read once the segment is done
+    size_t _frames_composed;
+    size_t _frames_merged;
+    int64_t _last_tick;
+
+    // encoded packets waiting for the muxer
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<AVPacket*> _packets;
+    bool _encoded_all;
+    std::optional<std::string> _error;
+
+    void compose();
+    void encode();
+
+    // hands the packets to the muxer, clearing packets
+    void deliver(std::vector<AVPacket*>& packets);
+
+    // stops both threads, keeping the first error
+    void fail(const std::string& error);
+
+public:
+    // renders into an options.width x options.height frame
+    RenderSegment(const CursorPixel& cursors, const RenderOptions& options, DitherMode dither);
+    RenderSegment(const RenderSegment&) = delete;
+
+    // opens the container, which gives the video's length to split it into segments
+    std::optional<std::string> probe(const char* video_filename, const DecoderOptions& decoder_options);
+
+    // sets up decoding from start to end, composing on compose_threads, and an encoder for format
+    // frames keep the source's timing from origin, in ticks of 1 / frame_rate, so start and end should fall on ticks
+    std::optional<std::string> open(const DecoderOptions& decoder_options, size_t ring_depth, size_t compose_threads, std::chrono::nanoseconds origin,
+                                    std::chrono::nanoseconds start, std::chrono::nanoseconds end, const AVOutputFormat* format, AVRational frame_rate,
+                                    const EncoderOptions& encoder_options);
+
+    void start();
+
+    // waits for the next encoded packet, null once the segment is done or has failed
+    // the packet belongs to the caller
+    AVPacket* next_packet();
+
+    // set once next_packet() returned null if the segment failed
+    std::optional<std::string> error();
+
+    const VideoPlayer& video_player() const
+    {
+        return _source.video_player();
+    }
+
+    const VideoEncoder& encoder() const
+    {
+        return _encoder;
+    }
+
+    std::chrono::nanoseconds start_time() const
+    {
+        return _start;
+    }
+
+    // frames composed, all of them once next_packet() returned null
+    size_t frames() const
+    {
+        return _frames_composed;
+    }
+
+    // frames left out for landing on the same tick as the one before, which only variable frame rate video has
+    size_t frames_merged() const
+    {
+        return _frames_merged;
+    }
+
+    // the tick after the segment's last frame, counted from the origin
+    int64_t end_tick() const
+    {
+        return _last_tick + 1;
+    }
+
+    // stops the threads early if they are still running
+    ~RenderSegment();
+};
+
+// Renders a video into a video file of the composited cursors, as fast as the machine allows.
+// There is no display and no pacing. The video is split into segments which render in parallel,
+// and their packets are muxed in order into one file as they arrive, so only segments which
+// finish ahead of the one being written wait in memory.
+class OfflineRenderer
+{
+private:
+    const CursorPixel& _cursors;
+    RenderOptions _options;
+    VideoMuxer _muxer;
+    std::vector<std::unique_ptr<RenderSegment>> _segments;
+    AVRational _frame_rate;
+
+    size_t _frames;
+    std::chrono::nanoseconds _video_time;
+    std::chrono::nanoseconds _render_time;
+
+public:
+    OfflineRenderer(const CursorPixel& cursors, const RenderOptions& options);
+    OfflineRenderer(const OfflineRenderer&) = delete;
+
+    // probes the video, splits it into segments from start_time and sets up every segment's pipeline and the output file
+    std::optional<std::string> open(const char* video_filename, const DecoderOptions& decoder_options, DitherMode dither,
+                                    std::chrono::nanoseconds start_time, size_t compose_threads, size_t ring_depth);
+
+    // renders every segment and writes the file, blocking until it is done
+    std::optional<std::string> run();
+
+    size_t segment_count() const
+    {
+        return _segments.size();
+    }
+
+    const RenderSegment& segment(size_t index) const
+    {
+        return *_segments[index];
+    }
+
+    AVRational frame_rate() const
+    {
+        return _frame_rate;
+    }
+
+    // after run()
+    size_t frames() const
+    {
+        return _frames;
+    }
+
+    // length of the rendered video
+    std::chrono::nanoseconds video_time() const
+    {
+        return _video_time;
+    }
+
+    std::chrono::nanoseconds render_time() const
+    {
+        return _render_time;
+    }
+};
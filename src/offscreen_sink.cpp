@@ -0,0 +1,71 @@
+#include <iostream>
+#include <cstdio>
+
+#include "offscreen_sink.h"
+
+OffscreenSink::OffscreenSink(size_t width, size_t height, std::string dump_directory, DumpFormat dump_format)
+:
+_pixels(width * height),
+_backbuffer(_pixels.data(), width, height),
+_dump_directory(std::move(dump_directory)),
+_dump_format(dump_format),
+_frame_index(0)
+{
+}
+
+void OffscreenSink::present(const std::vector<RectangleRegion>&)
+{
+    // the frame is already complete in memory
+    if (!_dump_directory.empty())
+    {
+        dump_frame();
+    }
+
+    _frame_index++;
+}
+
+void OffscreenSink::dump_frame()
+{
+    char filename[64];
+
+    std::snprintf(filename, sizeof(filename), "/frame_%06zu.%s", _frame_index, _dump_format == DumpFormat::PPM ? "ppm" : "raw");
+
+    std::string path = _dump_directory + filename;
+    FILE* file = std::fopen(path.c_str(), "wb");
+
+    if (!file)
+    {
+        std::cerr << "error: could not write " << path << std::endl;
+
+        return;
+    }
+
+    if (_dump_format == DumpFormat::Raw)
+    {
+        std::fwrite(_backbuffer.pixels, sizeof(uint32_t), _backbuffer.width * _backbuffer.height, file);
+    }
+    else
+    {
+        std::fprintf(file, "P6\n%zu %zu\n255\n", _backbuffer.width, _backbuffer.height);
+
+        std::vector<uint8_t> row(_backbuffer.width * 3);
+
+        for (size_t y = 0; y < _backbuffer.height; y++)
+        {
+            for (size_t x = 0; x < _backbuffer.width; x++)
+            {
+                // cursor pixels are premultiplied, so compositing over white just adds the missing coverage
+                uint32_t pixel = _backbuffer.pixels[y * _backbuffer.width + x];
+                uint8_t background = 255 - (pixel >> 24);
+
+                row[x * 3 + 0] = (uint8_t)((pixel >> 16) & 0xff) + background;
+                row[x * 3 + 1] = (uint8_t)((pixel >> 8) & 0xff) + background;
+                row[x * 3 + 2] = (uint8_t)(pixel & 0xff) + background;
+            }
+
+            std::fwrite(row.data(), 1, row.size(), file);
+        }
+    }
+
+    std::fclose(file);
+}
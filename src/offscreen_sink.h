@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "render_sink.h"
+#include "aligned_buffer.h"
+
+enum class DumpFormat
+{
+    PPM, // composited over white, as it would look on a light desktop
+    Raw  // the backbuffer's premultiplied ARGB pixels as they are
+};
+
+// Keeps frames in memory so playback can run without an X display,
+// optionally writing every presented frame out to a directory
+class OffscreenSink : public RenderSink
+{
+private:
+    AlignedBuffer<uint32_t> _pixels;
+    ImageBuffer<uint32_t> _backbuffer;
+    std::string _dump_directory;
+    DumpFormat _dump_format;
+    size_t _frame_index;
+
+    void dump_frame();
+
+public:
+    // dump_directory: where frames are written, empty to keep them in memory only
+    OffscreenSink(size_t width, size_t height, std::string dump_directory = "", DumpFormat dump_format = DumpFormat::PPM);
+    OffscreenSink(const OffscreenSink&) = delete;
+
+    ImageBuffer<uint32_t>& backbuffer() override
+    {
+        return _backbuffer;
+    }
+
+    void present(const std::vector<RectangleRegion>& dirty_regions) override;
+};
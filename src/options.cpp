@@ -0,0 +1,410 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include "options.h"
+
+namespace
+{
+    // parses the value following an option, eg. "--ring-depth 4"
+    std::optional<std::string> parse_size(int argc, const char* const argv[], int& i, size_t min, size_t& value)
+    {
+        if (i + 1 >= argc)
+        {
+            return std::string("missing value for '") + argv[i] + "'";
+        }
+
+        const char* text = argv[++i];
+        char* end = nullptr;
+        unsigned long long parsed = std::strtoull(text, &end, 10);
+
+        if (end == text || *end != '\0' || text[0] == '-' || parsed < min)
+        {
+            return std::string("invalid value '") + text + "' for '" + argv[i - 1] + "'";
+        }
+
+        value = parsed;
+
+        return {};
+    }
+
+    // parses the value following an option, eg. "--size 1920x1080"
+    std::optional<std::string> parse_dimensions(int argc, const char* const argv[], int& i, size_t& width, size_t& height)
+    {
+        if (i + 1 >= argc)
+        {
+            return std::string("missing value for '") + argv[i] + "'";
+        }
+
+        const char* text = argv[++i];
+        char* end = nullptr;
+        unsigned long long parsed_width = std::strtoull(text, &end, 10);
+
+        if (end == text || *end != 'x')
+        {
+            return std::string("invalid size '") + text + "', expected <width>x<height>";
+        }
+
+        const char* height_text = end + 1;
+        unsigned long long parsed_height = std::strtoull(height_text, &end, 10);
+
+        if (end == height_text || *end != '\0' || parsed_width == 0 || parsed_height == 0)
+        {
+            return std::string("invalid size '") + text + "', expected <width>x<height>";
+        }
+
+        width = parsed_width;
+        height = parsed_height;
+
+        return {};
+    }
+
+    // parses the value following an option, eg. "--seek 12.5"
+    std::optional<std::string> parse_seconds(int argc, const char* const argv[], int& i, std::chrono::nanoseconds& value)
+    {
+        if (i + 1 >= argc)
+        {
+            return std::string("missing value for '") + argv[i] + "'";
+        }
+
+        const char* text = argv[++i];
+        char* end = nullptr;
+        double seconds = std::strtod(text, &end);
+
+        if (end == text || *end != '\0' || !(seconds >= 0.0))
+        {
+            return std::string("invalid time '") + text + "' for '" + argv[i - 1] + "', expected seconds";
+        }
+
+        value = std::chrono::nanoseconds((int64_t)(seconds * 1e9));
+
+        return {};
+    }
+
+    // parses the value following an option as a string
+    std::optional<std::string> parse_string(int argc, const char* const argv[], int& i, std::string& value)
+    {
+        if (i + 1 >= argc)
+        {
+            return std::string("missing value for '") + argv[i] + "'";
+        }
+
+        value = argv[++i];
+
+        return {};
+    }
+}
+
+void print_usage(const char* program_name)
+{
+    std::cout << "usage: " << program_name << " [options] <video or cell stream file, - for stdin>\n"
+              << "       " << program_name << " [options] <video> <video>...    plays the videos side by side in tiles\n"
+              << "\n"
+              << "options:\n"
+              << "  --backend <name>    image, present, xrender or pixmap (default: image)\n"
+              << "                      present shows frames at vblank through the Present extension\n"
+              << "                      xrender and pixmap upload the cursors once and only send changed cells\n"
+              << "  --monitors <layout> pointer, span or mirror (default: pointer)\n"
+              << "                      span stretches the video across every monitor, mirror shows it on each\n"
+              << "  --no-shm            present with XPutImage even if MIT-SHM is available\n"
+              << "  --shm-buffers <n>   MIT-SHM segments to cycle through, 1 waits for every frame (default: 2, up to 3)\n"
+              << "  --ring-depth <n>    frames decoded ahead of playback (default: 4)\n"
+              << "  --decode-threads <n>\n"
+              << "                      threads used by the video decoder (default: one per core)\n"
+              << "  --decode-threading <type>\n"
+              << "                      auto, frame or slice (default: auto)\n"
+              << "  --low-delay         ask the decoder not to hold frames back, rules out frame threading\n"
+              << "  --no-mmap           read video files with libav's buffered I/O instead of memory mapping them\n"
+              << "  --probesize <bytes> streams: bytes probed for stream parameters before playing (default: 32768)\n"
+              << "  --analyzeduration <seconds>\n"
+              << "                      streams: stream time probed for parameters before playing (default: 0.2)\n"
+              << "  --buffer-stream     streams: let the demuxer buffer packets ahead of the decoder\n"
+              << "  --swscale           always scale frames with swscale instead of averaging the luma plane directly\n"
+              << "  --threads <n>       threads used to composite frames, and to decode them when playing tiles (default: one per core)\n"
+              << "  --dither <mode>     none, ordered or diffusion (default: none)\n"
+              << "  --headless          render into memory instead of a window, no X display needed\n"
+              << "  --size <w>x<h>      headless, transcode, render: screen size in pixels (default: 1920x1080)\n"
+              << "  --dump-frames <dir> headless: write every frame into <dir>\n"
+              << "  --dump-format <fmt> ppm or raw premultiplied ARGB (default: ppm)\n"
+              << "  --golden <file>     check every frame against hashes recorded in <file>\n"
+              << "  --record-golden <file>\n"
+              << "                      record the hash of every frame into <file>\n"
+              << "  --unpaced           play as fast as possible instead of at the video's framerate\n"
+              << "  --seek <seconds>    start playback this far into the video\n"
+              << "  --loop              start again from the beginning once the video ends\n"
+              << "  --fixed-quality     never lower dithering, scaling or the presented framerate when playback falls behind\n"
+              << "  --stats             print per-frame statistics\n"
+              << "  --verbose           print how long each part of startup took\n"
+              << "  --no-cursor-cache   load the cursor shades from the theme instead of the atlas cache, and don't write it\n"
+              << "  --transcode <file>  convert the video into a precompiled cell stream instead of playing it\n"
+              << "  --grid <w>x<h>      transcode: cell grid size (default: the grid covering --size)\n"
+              << "  --keyframe-interval <n>\n"
+              << "                      transcode: frames between keyframes (default: two seconds)\n"
+              << "  --render <file>     encode the composited frames into a video file (eg. out.mp4) as fast as possible, no display needed\n"
+              << "  --segments <n>      render: split the video into <n> parts rendered in parallel (default: 1)\n"
+              << "  --encoder <name>    render: libavcodec encoder, eg. libx264 (default: the container's usual one)\n"
+              << "  --bitrate <kbit/s>  render: target bitrate (default: about 8000 at 1080p30)\n"
+              << "  --trace <file>      write per-stage timings as a Chrome trace (needs make TRACE=1)\n"
+              << "  -h, --help          show this message\n";
+}
+
+std::optional<std::string> parse_options(int argc, const char* const argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0)
+        {
+            options.show_help = true;
+
+            return {};
+        }
+        else if (std::strcmp(arg, "--backend") == 0)
+        {
+            std::string backend;
+
+            if (auto err = parse_string(argc, argv, i, backend)) return err;
+
+            if (backend == "image") options.backend = RenderBackend::Image;
+            else if (backend == "xrender") options.backend = RenderBackend::GlyphSet;
+            else if (backend == "pixmap") options.backend = RenderBackend::PixmapTiles;
+            else if (backend == "present") options.backend = RenderBackend::Present;
+            else return "unknown backend '" + backend + "'";
+        }
+        else if (std::strcmp(arg, "--monitors") == 0)
+        {
+            std::string layout;
+
+            if (auto err = parse_string(argc, argv, i, layout)) return err;
+
+            if (layout == "pointer") options.monitors = MonitorLayout::Pointer;
+            else if (layout == "span") options.monitors = MonitorLayout::Span;
+            else if (layout == "mirror") options.monitors = MonitorLayout::Mirror;
+            else return "unknown monitor layout '" + layout + "'";
+        }
+        else if (std::strcmp(arg, "--no-shm") == 0)
+        {
+            options.use_shm = false;
+        }
+        else if (std::strcmp(arg, "--shm-buffers") == 0)
+        {
+            if (auto err = parse_size(argc, argv, i, 1, options.shm_buffers)) return err;
+
+            if (options.shm_buffers > 3) return "--shm-buffers takes 1 to 3 buffers";
+        }
+        else if (std::strcmp(arg, "--ring-depth") == 0)
+        {
+            if (auto err = parse_size(argc, argv, i, 1, options.ring_depth)) return err;
+        }
+        else if (std::strcmp(arg, "--decode-threads") == 0)
+        {
+            size_t thread_count = 0;
+
+            if (auto err = parse_size(argc, argv, i, 1, thread_count)) return err;
+
+            options.decoder.thread_count = (int)thread_count;
+        }
+        else if (std::strcmp(arg, "--decode-threading") == 0)
+        {
+            std::string threading;
+
+            if (auto err = parse_string(argc, argv, i, threading)) return err;
+
+            if (threading == "auto") options.decoder.threading = DecoderThreading::Auto;
+            else if (threading == "frame") options.decoder.threading = DecoderThreading::Frame;
+            else if (threading == "slice") options.decoder.threading = DecoderThreading::Slice;
+            else return "unknown decoder threading '" + threading + "'";
+        }
+        else if (std::strcmp(arg, "--low-delay") == 0)
+        {
+            options.decoder.low_delay = true;
+        }
+        else if (std::strcmp(arg, "--no-mmap") == 0)
+        {
+            options.decoder.input.map_files = false;
+        }
+        else if (std::strcmp(arg, "--probesize") == 0)
+        {
+            // libav won't probe less than 32 bytes
+            if (auto err = parse_size(argc, argv, i, 32, options.decoder.input.probe_size)) return err;
+        }
+        else if (std::strcmp(arg, "--analyzeduration") == 0)
+        {
+            std::chrono::nanoseconds duration;
+
+            if (auto err = parse_seconds(argc, argv, i, duration)) return err;
+
+            options.decoder.input.analyze_duration = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+        }
+        else if (std::strcmp(arg, "--buffer-stream") == 0)
+        {
+            options.decoder.input.no_buffer = false;
+        }
+        else if (std::strcmp(arg, "--swscale") == 0)
+        {
+            options.decoder.direct_luma = false;
+        }
+        else if (std::strcmp(arg, "--threads") == 0)
+        {
+            if (auto err = parse_size(argc, argv, i, 1, options.compose_threads)) return err;
+        }
+        else if (std::strcmp(arg, "--dither") == 0)
+        {
+            std::string mode;
+
+            if (auto err = parse_string(argc, argv, i, mode)) return err;
+
+            if (mode == "none") options.dither = DitherMode::Disabled;
+            else if (mode == "ordered") options.dither = DitherMode::Ordered;
+            else if (mode == "diffusion") options.dither = DitherMode::ErrorDiffusion;
+            else return "unknown dither mode '" + mode + "'";
+        }
+        else if (std::strcmp(arg, "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if (std::strcmp(arg, "--size") == 0)
+        {
+            if (auto err = parse_dimensions(argc, argv, i, options.headless_width, options.headless_height)) return err;
+        }
+        else if (std::strcmp(arg, "--dump-frames") == 0)
+        {
+            if (auto err = parse_string(argc, argv, i, options.dump_directory)) return err;
+        }
+        else if (std::strcmp(arg, "--dump-format") == 0)
+        {
+            std::string format;
+
+            if (auto err = parse_string(argc, argv, i, format)) return err;
+
+            if (format == "ppm") options.dump_format = DumpFormat::PPM;
+            else if (format == "raw") options.dump_format = DumpFormat::Raw;
+            else return "unknown dump format '" + format + "'";
+        }
+        else if (std::strcmp(arg, "--golden") == 0 || std::strcmp(arg, "--record-golden") == 0)
+        {
+            if (auto err = parse_string(argc, argv, i, options.golden_filename)) return err;
+
+            options.golden_mode = std::strcmp(arg, "--golden") == 0 ? GoldenFrames::Mode::Check : GoldenFrames::Mode::Record;
+        }
+        else if (std::strcmp(arg, "--unpaced") == 0)
+        {
+            options.unpaced = true;
+        }
+        else if (std::strcmp(arg, "--seek") == 0)
+        {
+            if (auto err = parse_seconds(argc, argv, i, options.start_time)) return err;
+        }
+        else if (std::strcmp(arg, "--loop") == 0)
+        {
+            options.loop = true;
+        }
+        else if (std::strcmp(arg, "--fixed-quality") == 0)
+        {
+            options.fixed_quality = true;
+        }
+        else if (std::strcmp(arg, "--verbose") == 0)
+        {
+            options.verbose = true;
+        }
+        else if (std::strcmp(arg, "--no-cursor-cache") == 0)
+        {
+            options.cursor_cache = false;
+        }
+        else if (std::strcmp(arg, "--stats") == 0)
+        {
+            options.print_stats = true;
+        }
+        else if (std::strcmp(arg, "--transcode") == 0)
+        {
+            if (auto err = parse_string(argc, argv, i, options.transcode_filename)) return err;
+        }
+        else if (std::strcmp(arg, "--grid") == 0)
+        {
+            if (auto err = parse_dimensions(argc, argv, i, options.grid_width, options.grid_height)) return err;
+        }
+        else if (std::strcmp(arg, "--keyframe-interval") == 0)
+        {
+            if (auto err = parse_size(argc, argv, i, 1, options.keyframe_interval)) return err;
+        }
+        else if (std::strcmp(arg, "--render") == 0)
+        {
+            if (auto err = parse_string(argc, argv, i, options.render_filename)) return err;
+        }
+        else if (std::strcmp(arg, "--segments") == 0)
+        {
+            if (auto err = parse_size(argc, argv, i, 1, options.render_segments)) return err;
+        }
+        else if (std::strcmp(arg, "--encoder") == 0)
+        {
+            if (auto err = parse_string(argc, argv, i, options.encoder.codec_name)) return err;
+        }
+        else if (std::strcmp(arg, "--bitrate") == 0)
+        {
+            size_t kbits = 0;
+
+            if (auto err = parse_size(argc, argv, i, 1, kbits)) return err;
+
+            options.encoder.bit_rate = (int64_t)kbits * 1000;
+        }
+        else if (std::strcmp(arg, "--trace") == 0)
+        {
+#ifndef CURSOR_VIDEO_TRACE
+            return "--trace needs a build with tracing, rebuild with make clean && make TRACE=1";
+#endif
+            if (auto err = parse_string(argc, argv, i, options.trace_filename)) return err;
+        }
+        else if (arg[0] == '-' && arg[1] != '\0')
+        {
+            return std::string("unknown option '") + arg + "'";
+        }
+        else
+        {
+            options.video_filenames.push_back(arg);
+        }
+    }
+
+    if (!options.video_filenames.empty())
+    {
+        options.video_filename = options.video_filenames.front();
+    }
+
+    if (!options.dump_directory.empty() && !options.headless)
+    {
+        return "--dump-frames only works together with --headless";
+    }
+
+    if (options.backend != RenderBackend::Image && options.headless)
+    {
+        return "--headless only works with the image backend";
+    }
+
+    if (options.backend != RenderBackend::Image && options.backend != RenderBackend::Present && options.golden_mode)
+    {
+        return "golden frames are hashed from the composited image, so they need the image or present backend";
+    }
+
+    if (options.monitors != MonitorLayout::Pointer && (options.headless || options.golden_mode))
+    {
+        return "--monitors span and mirror need a display, so they don't work with --headless or golden frames";
+    }
+
+    if (!options.render_filename.empty() && (!options.transcode_filename.empty() || options.loop || options.golden_mode || options.video_filenames.size() > 1))
+    {
+        return "--render encodes one video from start to end, so it doesn't work with --transcode, --loop, golden frames or tiles";
+    }
+
+    if (options.video_filenames.size() > 1 && (!options.transcode_filename.empty() || options.monitors != MonitorLayout::Pointer ||
+        (options.backend != RenderBackend::Image && options.backend != RenderBackend::Present)))
+    {
+        return "tiled videos are composed into one window, so they need the image or present backend and don't work with --monitors or --transcode";
+    }
+
+    if (!options.video_filename)
+    {
+        return "Please provide a filename to the video which you intend on playing";
+    }
+
+    return {};
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <chrono>
+
+#include "quantize.h"
+#include "offscreen_sink.h"
+#include "golden.h"
+#include "video_player.h"
+#include "frame_renderer.h"
+#include "video_encoder.h"
+
+struct Options
+{
+    const char* video_filename = nullptr;
+
+    // every video given, more than one plays them side by side in tiles (see TiledVideoSource)
+    std::vector<const char*> video_filenames;
+    bool show_help = false;
+
+    // how frames get to the X server
+    RenderBackend backend = RenderBackend::Image;
+
+    // which monitors to play on
+    MonitorLayout monitors = MonitorLayout::Pointer;
+
+    // present frames through a MIT-SHM segment when the server supports it
+    bool use_shm = true;
+
+    // MIT-SHM segments cycled through, so the next frame is composed while the server still reads the last one
+    size_t shm_buffers = 2;
+
+    // number of frames decoded ahead of playback
+    size_t ring_depth = 4;
+
+    DecoderOptions decoder;
+
+    // threads used to composite each frame, 0 picks one per core
+    // tiled playback decodes on the same threads
+    size_t compose_threads = 0;
+
+    DitherMode dither = DitherMode::Disabled;
+
+    // render into memory instead of an X11 window
+    bool headless = false;
+    size_t headless_width = 1920;
+    size_t headless_height = 1080;
+
+    // headless: write every frame into this directory
+    std::string dump_directory;
+    DumpFormat dump_format = DumpFormat::PPM;
+
+    // record or check the hash of every frame
+    std::optional<GoldenFrames::Mode> golden_mode;
+    std::string golden_filename;
+
+    // play frames as fast as possible instead of at the video's framerate
+    bool unpaced = false;
+
+    // start playback at this time into the video
+    std::chrono::nanoseconds start_time{ 0 };
+
+    // start again from the beginning once the video ends
+    bool loop = false;
+
+    // print per-frame statistics (eg. how much of the grid was recomposed)
+    bool print_stats = false;
+
+    // keep the quality fixed instead of letting QualityGovernor trade it for speed when frames run late
+    bool fixed_quality = false;
+
+    // print how long each part of startup took
+    bool verbose = false;
+
+    // keep the cropped cursor shades in a cache file between launches
+    bool cursor_cache = true;
+
+    // convert the video into a cell stream file instead of playing it
+    std::string transcode_filename;
+
+    // transcode: size of the cell grid, 0 to cover a screen of headless_width x headless_height
+    size_t grid_width = 0;
+    size_t grid_height = 0;
+
+    // transcode: frames between keyframes, 0 for one every two seconds
+    size_t keyframe_interval = 0;
+
+    // render the composited frames into this video file instead of playing them, as fast as possible
+    std::string render_filename;
+
+    // render: parts of the video rendered in parallel, joined into the one file
+    size_t render_segments = 1;
+
+    EncoderOptions encoder;
+
+    // write the stage timings as a Chrome trace, needs a build with tracing
+    std::string trace_filename;
+};
+
+// prints the command line usage to stdout
+void print_usage(const char* program_name);
+
+// fills options from the command line
+// returns an error message on failure
+std::optional<std::string> parse_options(int argc, const char* const argv[], Options& options);
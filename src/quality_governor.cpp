@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "quality_governor.h"
+
+namespace
+{
+    const size_t bad_windows_to_step_down = 2;
+    const size_t good_windows_to_step_up = 3;
+
+    // a window is bad above this load or share of dropped frames
+    const double overload = 0.95;
+    const double drop_share = 0.05;
+
+    // and good when the level above would stay under this load
+    const double headroom = 0.7;
+
+    // what dithering and scaling cost isn't measured separately, so assume the level above costs this much more
+    const double unmeasured_step_cost = 1.25;
+}
+
+QualityGovernor::QualityGovernor(double framerate, DitherMode dither, bool can_dither, bool can_fast_scale)
+:
+_level(0),
+_frame_duration(framerate > 0.0 ? (int64_t)(1e9 / framerate) : 0),
+_window_frames(std::max((size_t)std::lround(framerate), (size_t)1)),
+_slots(0),
+_frame_counter(0),
+_dropped_at_window_start(0),
+_work_time(0),
+_bad_windows(0),
+_good_windows(0),
+_changes(0)
+{
+    _levels.push_back({ "full quality", dither, false, 1 });
+
+    // a level which saves no work would only delay the ones which do
+    DitherMode cheapest_dither = can_dither ? DitherMode::Disabled : dither;
+
+    if (can_dither && dither == DitherMode::ErrorDiffusion) _levels.push_back({ "ordered dithering", DitherMode::Ordered, false, 1 });
+    if (can_dither && dither != DitherMode::Disabled) _levels.push_back({ "no dithering", DitherMode::Disabled, false, 1 });
+    if (can_fast_scale) _levels.push_back({ "fast scaling", cheapest_dither, true, 1 });
+
+    _levels.push_back({ "every 2nd frame", cheapest_dither, can_fast_scale, 2 });
+    _levels.push_back({ "every 3rd frame", cheapest_dither, can_fast_scale, 3 });
+}
+
+bool QualityGovernor::begin_frame()
+{
+    _slots++;
+
+    return _frame_counter++ % level().present_interval == 0;
+}
+
+double QualityGovernor::load_after_step_up(double load) const
+{
+    const QualityLevel& current = _levels[_level];
+    const QualityLevel& above = _levels[_level - 1];
+
+    // the work is per presented frame, so presenting more often adds to the load in proportion
+    if (above.present_interval != current.present_interval)
+    {
+        return load * current.present_interval / above.present_interval;
+    }
+
+    return load * unmeasured_step_cost;
+}
+
+bool QualityGovernor::end_frame(std::chrono::nanoseconds work_time, size_t frames_dropped)
+{
+    _work_time += work_time;
+
+    size_t drops = frames_dropped - _dropped_at_window_start;
+    size_t slots = _slots + drops;
+
+    // unpaced or unknown framerate, there's no budget to compare against
+    if (slots < _window_frames || _frame_duration.count() == 0)
+    {
+        return false;
+    }
+
+    double load = (double)_work_time.count() / (slots * _frame_duration.count());
+
+    _slots = 0;
+    _work_time = std::chrono::nanoseconds(0);
+    _dropped_at_window_start = frames_dropped;
+
+    if (load > overload || drops > drop_share * slots)
+    {
+        _bad_windows++;
+        _good_windows = 0;
+    }
+    else if (drops == 0 && _level > 0 && load_after_step_up(load) < headroom)
+    {
+        _good_windows++;
+        _bad_windows = 0;
+    }
+    else
+    {
+        _bad_windows = 0;
+        _good_windows = 0;
+    }
+
+    if (_bad_windows >= bad_windows_to_step_down && _level + 1 < _levels.size())
+    {
+        change_level(_level + 1, "down", load, drops, slots);
+
+        return true;
+    }
+
+    if (_good_windows >= good_windows_to_step_up)
+    {
+        change_level(_level - 1, "up", load, drops, slots);
+
+        return true;
+    }
+
+    return false;
+}
+
+void QualityGovernor::change_level(size_t level, const char* direction, double load, size_t drops, size_t slots)
+{
+    char decision[128];
+
+    std::snprintf(decision, sizeof(decision), "%s to %s: %.0f%% load, %zu frames dropped in the last %zu",
+                  direction, _levels[level].name, load * 100.0, drops, slots);
+
+    _level = level;
+    _last_decision = decision;
+    _changes++;
+
+    // the new level gets judged on its own windows
+    _bad_windows = 0;
+    _good_windows = 0;
+}
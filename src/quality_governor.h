@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstddef>
+
+#include "quantize.h"
+
+// What one step of the governor's ladder does to cut the work per frame
+struct QualityLevel
+{
+    const char* name;
+    DitherMode dither;
+
+    // cheaper swscale filtering, for video which doesn't go through the direct luma path
+    bool fast_scaling;
+
+    // only every present_interval-th frame is composed and presented
+    size_t present_interval;
+};
+
+// Closes the loop between frame timing and the work done per frame.
+//
+// Every second of playback (a window of frame slots) is judged by its load, the time spent
+// quantizing, composing and presenting over the time the frames were on screen, and by how
+// many frames the scheduler dropped. Two bad windows in a row step down a level: first
+// cheaper dithering and scaling where the source has them, then presenting only every
+// second or third frame.
+// Three good windows in a row, with room to spare even at the level above, step back up.
+// The different thresholds and window counts keep it from flapping between two levels.
+class QualityGovernor
+{
+private:
+    std::vector<QualityLevel> _levels;
+    size_t _level;
+    std::chrono::nanoseconds _frame_duration;
+
+    // the current window
+    size_t _window_frames;
+    size_t _slots;
+    size_t _frame_counter;
+    size_t _dropped_at_window_start;
+    std::chrono::nanoseconds _work_time;
+
+    size_t _bad_windows;
+    size_t _good_windows;
+    size_t _changes;
+    std::string _last_decision;
+
+    // load the level above would have, from the load measured at this one
+    double load_after_step_up(double load) const;
+
+    void change_level(size_t level, const char* direction, double load, size_t drops, size_t slots);
+
+public:
+    // framerate: the video's rate, which sets the time budget of a frame
+    // dither: the dither asked for on the command line, used at full quality
+    // can_dither, can_fast_scale: the source quantizes and scales its frames itself, so levels changing those save work
+    // (not so for eg. cell streams, or video on the direct luma path)
+    QualityGovernor(double framerate, DitherMode dither, bool can_dither, bool can_fast_scale);
+
+    // call for every frame the scheduler hasn't dropped
+    // returns false for frames the current level skips, which mustn't be composed or presented
+    bool begin_frame();
+
+    // call after every frame begin_frame() accepted
+    // work_time: time spent quantizing, composing and presenting it, without waiting for its deadline
+    // frames_dropped: the scheduler's running total of dropped frames
+    // returns true when the level changed, see level() and last_decision()
+    bool end_frame(std::chrono::nanoseconds work_time, size_t frames_dropped);
+
+    const QualityLevel& level() const
+    {
+        return _levels[_level];
+    }
+
+    // 0 is full quality
+    size_t level_index() const
+    {
+        return _level;
+    }
+
+    size_t changes() const
+    {
+        return _changes;
+    }
+
+    // why the last change was made, eg. "down to every 2nd frame: 131% load, 4 frames dropped"
+    const std::string& last_decision() const
+    {
+        return _last_decision;
+    }
+};
@@ -0,0 +1,252 @@
+#include <algorithm>
+
+#include "quantize.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+
+    #define QUANTIZE_X86 1
+#endif
+
+namespace
+{
+    const uint8_t bayer_matrix[4][4] = {
+        {  0,  8,  2, 10 },
+        { 12,  4, 14,  6 },
+        {  3, 11,  1,  9 },
+        { 15,  7, 13,  5 }
+    };
+
+    struct KernelArgs
+    {
+        const uint8_t* shades;
+        uint8_t* indices;
+        size_t count;
+        const uint8_t* thresholds;
+        const uint8_t* index_table;
+        size_t levels;
+        const uint8_t* dither_add; // null when not dithering
+        const uint8_t* dither_sub;
+    };
+
+    // dither offsets repeat every 4 pixels, so any offset into the 32 byte rows lines up as long as x is a multiple of 4
+    void quantize_row_scalar(const KernelArgs& args, size_t x)
+    {
+        if (!args.dither_add)
+        {
+            for (; x < args.count; x++)
+            {
+                args.indices[x] = args.index_table[args.shades[x]];
+            }
+
+            return;
+        }
+
+        for (; x < args.count; x++)
+        {
+            int shade = std::clamp(args.shades[x] + args.dither_add[x & 31] - args.dither_sub[x & 31], 0, 255);
+
+            args.indices[x] = args.index_table[shade];
+        }
+    }
+
+#ifdef QUANTIZE_X86
+    void quantize_row_sse2(const KernelArgs& args)
+    {
+        const __m128i dither_add = args.dither_add ? _mm_load_si128((const __m128i*)args.dither_add) : _mm_setzero_si128();
+        const __m128i dither_sub = args.dither_sub ? _mm_load_si128((const __m128i*)args.dither_sub) : _mm_setzero_si128();
+        size_t x = 0;
+
+        for (; x + 16 <= args.count; x += 16)
+        {
+            __m128i shades = _mm_loadu_si128((const __m128i*)(args.shades + x));
+
+            shades = _mm_subs_epu8(_mm_adds_epu8(shades, dither_add), dither_sub);
+
+            // every threshold the shade reaches adds one to the index (the compare mask is -1)
+            __m128i index = _mm_setzero_si128();
+
+            for (size_t k = 0; k < args.levels; k++)
+            {
+                __m128i threshold = _mm_set1_epi8((char)args.thresholds[k]);
+                __m128i reached = _mm_cmpeq_epi8(_mm_max_epu8(shades, threshold), shades);
+
+                index = _mm_sub_epi8(index, reached);
+            }
+
+            _mm_storeu_si128((__m128i*)(args.indices + x), index);
+        }
+
+        quantize_row_scalar(args, x);
+    }
+
+    __attribute__((target("avx2")))
+    void quantize_row_avx2(const KernelArgs& args)
+    {
+        const __m256i dither_add = args.dither_add ? _mm256_load_si256((const __m256i*)args.dither_add) : _mm256_setzero_si256();
+        const __m256i dither_sub = args.dither_sub ? _mm256_load_si256((const __m256i*)args.dither_sub) : _mm256_setzero_si256();
+        size_t x = 0;
+
+        for (; x + 32 <= args.count; x += 32)
+        {
+            __m256i shades = _mm256_loadu_si256((const __m256i*)(args.shades + x));
+
+            shades = _mm256_subs_epu8(_mm256_adds_epu8(shades, dither_add), dither_sub);
+
+            __m256i index = _mm256_setzero_si256();
+
+            for (size_t k = 0; k < args.levels; k++)
+            {
+                __m256i threshold = _mm256_set1_epi8((char)args.thresholds[k]);
+                __m256i reached = _mm256_cmpeq_epi8(_mm256_max_epu8(shades, threshold), shades);
+
+                index = _mm256_sub_epi8(index, reached);
+            }
+
+            _mm256_storeu_si256((__m256i*)(args.indices + x), index);
+        }
+
+        quantize_row_scalar(args, x);
+    }
+#endif
+}
+
+ShadeQuantizer::ShadeQuantizer(size_t levels, DitherMode dither, QuantizeKernel kernel)
+:
+_levels(std::min(levels, (size_t)255)),
+_dither(dither),
+_kernel(kernel),
+_thresholds(),
+_index_table()
+{
+    if (_kernel == QuantizeKernel::Auto || !kernel_supported(_kernel))
+    {
+        _kernel = kernel_supported(QuantizeKernel::AVX2) ? QuantizeKernel::AVX2 :
+                  kernel_supported(QuantizeKernel::SSE2) ? QuantizeKernel::SSE2 :
+                  QuantizeKernel::Scalar;
+    }
+
+    // smallest shade where shade * (levels + 1) / 256 reaches k + 1
+    for (size_t k = 0; k < _levels; k++)
+    {
+        _thresholds[k] = (uint8_t)((256 * (k + 1) + _levels) / (_levels + 1));
+    }
+
+    for (size_t shade = 0; shade < 256; shade++)
+    {
+        _index_table[shade] = (uint8_t)(shade * (_levels + 1) / 256);
+    }
+
+    // spread the offsets over one quantization step, centred on zero
+    int step = 256 / (int)(_levels + 1);
+
+    for (size_t y = 0; y < 4; y++)
+    {
+        for (size_t x = 0; x < 32; x++)
+        {
+            int offset = ((2 * bayer_matrix[y][x & 3] + 1) * step) / 32 - step / 2;
+
+            _dither_add[y][x] = (uint8_t)std::max(offset, 0);
+            _dither_sub[y][x] = (uint8_t)std::max(-offset, 0);
+        }
+    }
+}
+
+bool ShadeQuantizer::kernel_supported(QuantizeKernel kernel)
+{
+    switch (kernel)
+    {
+        case QuantizeKernel::Auto:
+        case QuantizeKernel::Scalar:
+            return true;
+#ifdef QUANTIZE_X86
+        case QuantizeKernel::SSE2: return __builtin_cpu_supports("sse2");
+        case QuantizeKernel::AVX2: return __builtin_cpu_supports("avx2");
+#else
+        default: return false;
+#endif
+    }
+
+    return false;
+}
+
+const char* ShadeQuantizer::kernel_name(QuantizeKernel kernel)
+{
+    switch (kernel)
+    {
+        case QuantizeKernel::Auto: return "auto";
+        case QuantizeKernel::Scalar: return "scalar";
+        case QuantizeKernel::SSE2: return "sse2";
+        case QuantizeKernel::AVX2: return "avx2";
+    }
+
+    return "unknown";
+}
+
+void ShadeQuantizer::quantize(const ImageBuffer<uint8_t>& shades, ImageBuffer<uint8_t>& indices)
+{
+    if (_dither == DitherMode::ErrorDiffusion)
+    {
+        quantize_error_diffusion(shades, indices);
+
+        return;
+    }
+
+    for (size_t y = 0; y < shades.height; y++)
+    {
+        KernelArgs args = {
+            shades.pixels + y * shades.width,
+            indices.pixels + y * indices.width,
+            shades.width,
+            _thresholds,
+            _index_table,
+            _levels,
+            _dither == DitherMode::Ordered ? _dither_add[y & 3] : nullptr,
+            _dither == DitherMode::Ordered ? _dither_sub[y & 3] : nullptr
+        };
+
+        switch (_kernel)
+        {
+#ifdef QUANTIZE_X86
+            case QuantizeKernel::AVX2: quantize_row_avx2(args); break;
+            case QuantizeKernel::SSE2: quantize_row_sse2(args); break;
+#endif
+            default: quantize_row_scalar(args, 0); break;
+        }
+    }
+}
+
+void ShadeQuantizer::quantize_error_diffusion(const ImageBuffer<uint8_t>& shades, ImageBuffer<uint8_t>& indices)
+{
+    // each pixel depends on the error of the previous one, so this is always scalar
+    const int step = 256 / (int)(_levels + 1);
+
+    // padded by one on both sides so the neighbours of edge pixels don't need checks
+    _error_rows.assign((shades.width + 2) * 2, 0);
+
+    int16_t* current_errors = _error_rows.data() + 1;
+    int16_t* next_errors = current_errors + shades.width + 2;
+
+    for (size_t y = 0; y < shades.height; y++)
+    {
+        for (size_t x = 0; x < shades.width; x++)
+        {
+            int value = std::clamp(shades.pixels[y * shades.width + x] + current_errors[x], 0, 255);
+            size_t index = _index_table[value];
+
+            // the shade this index stands for is the middle of its step
+            int level_value = std::min((int)index * step + step / 2, 255);
+            int error = value - level_value;
+
+            indices.pixels[y * indices.width + x] = (uint8_t)index;
+
+            current_errors[x + 1] += error * 7 / 16;
+            next_errors[x - 1] += error * 3 / 16;
+            next_errors[x] += error * 5 / 16;
+            next_errors[x + 1] += error / 16;
+        }
+
+        std::swap(current_errors, next_errors);
+        std::fill(next_errors - 1, next_errors + shades.width + 1, 0);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "misc.h"
+
+enum class DitherMode
+{
+    Disabled,
+    Ordered,        // 4x4 Bayer matrix
+    ErrorDiffusion  // Floyd-Steinberg
+};
+
+enum class QuantizeKernel
+{
+    Auto,
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Turns a grey frame into a plane of cursor indices in one pass.
+// Indices match CursorPixel::get_cursor_index(), so `levels` (the number of cursor shades) means a blank cell.
+class ShadeQuantizer
+{
+private:
+    size_t _levels;
+    DitherMode _dither;
+    QuantizeKernel _kernel;
+
+    // shade >= _thresholds[k] means index > k
+    uint8_t _thresholds[256];
+
+    // the same mapping as a lookup table for the scalar paths
+    uint8_t _index_table[256];
+
+    // ordered dither offsets for each row of the Bayer matrix, split into the
+    // positive and negative halves so SIMD kernels can apply them with saturating adds
+    alignas(32) uint8_t _dither_add[4][32];
+    alignas(32) uint8_t _dither_sub[4][32];
+
+    // error diffusion carries the error of the current and next row
+    std::vector<int16_t> _error_rows;
+
+    void quantize_error_diffusion(const ImageBuffer<uint8_t>& shades, ImageBuffer<uint8_t>& indices);
+
+public:
+    ShadeQuantizer(size_t levels, DitherMode dither, QuantizeKernel kernel = QuantizeKernel::Auto);
+
+    void quantize(const ImageBuffer<uint8_t>& shades, ImageBuffer<uint8_t>& indices);
+
+    // takes effect from the next quantize(), eg. to trade dithering for speed mid-playback
+    void set_dither(DitherMode dither)
+    {
+        _dither = dither;
+    }
+
+    DitherMode dither() const
+    {
+        return _dither;
+    }
+
+    // the kernel in use after resolving Auto against the CPU
+    QuantizeKernel kernel() const
+    {
+        return _kernel;
+    }
+
+    static bool kernel_supported(QuantizeKernel kernel);
+    static const char* kernel_name(QuantizeKernel kernel);
+};
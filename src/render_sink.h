@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "misc.h"
+
+// Where composited frames go, eg. an X11 window or memory
+class RenderSink
+{
+public:
+    // the pixels frames are composited into, kept between frames
+    virtual ImageBuffer<uint32_t>& backbuffer() = 0;
+
+    // shows the regions of the backbuffer which changed since the last present
+    virtual void present(const std::vector<RectangleRegion>& dirty_regions) = 0;
+
+    // bytes sent to the X server so far, pixels in shared memory aren't counted
+    virtual uint64_t bytes_sent() const
+    {
+        return 0;
+    }
+
+    virtual ~RenderSink() = default;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Lets one side of an SpscQueue wait for the other without polling.
+//
+// wait() spins for a few microseconds, which catches handoffs that are about to happen,
+// then sleeps on a condition variable. notify() only takes the lock when someone is
+// asleep, so the queue stays lock-free while both sides keep up.
+class RingSignal
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::atomic<size_t> _sleepers;
+
+public:
+    // long enough to cover a handoff in progress, short against a frame
+    static constexpr std::chrono::microseconds spin_time{ 20 };
+
+    RingSignal()
+    :
+    _sleepers(0)
+    {
+    }
+
+    RingSignal(const RingSignal&) = delete;
+
+    // returns once ready() is true, which has to become true before the matching notify()
+    template <typename F>
+    void wait(F&& ready)
+    {
+        if (ready()) return;
+
+        auto spin_end = std::chrono::steady_clock::now() + spin_time;
+
+        while (std::chrono::steady_clock::now() < spin_end)
+        {
+            if (ready()) return;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        // seen by notify() before it checks for sleepers, or ready() sees what it published
+        _sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        _condition.wait(lock, ready);
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // call after publishing whatever ready() checks, eg. SpscQueue::push() or pop()
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (_sleepers.load(std::memory_order_relaxed) == 0) return;
+
+        // the lock makes sure a sleeper is either still checking ready() or already waiting
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+        }
+
+        _condition.notify_all();
+    }
+};
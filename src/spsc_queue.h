@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Slots are preallocated up front and written in place, so nothing is copied or allocated
+// while the queue is in use.
+template <typename T>
+class SpscQueue
+{
+private:
+    std::vector<T> _slots;
+
+    // monotonically increasing counters, the slot is counter % capacity
+    alignas(64) std::atomic<size_t> _head; // next slot the consumer reads
+    alignas(64) std::atomic<size_t> _tail; // next slot the producer writes
+
+public:
+    SpscQueue(std::vector<T> slots)
+    :
+    _slots(std::move(slots)),
+    _head(0),
+    _tail(0)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+
+    size_t capacity() const
+    {
+        return _slots.size();
+    }
+
+    // number of slots which are ready for the consumer
+    size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    // producer: the slot to fill next, or null when the queue is full
+    T* back()
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size())
+        {
+            return nullptr;
+        }
+
+        return &_slots[tail % _slots.size()];
+    }
+
+    // producer: hands the slot returned by back() over to the consumer
+    void push()
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer: the oldest ready slot, or null when the queue is empty
+    T* front()
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        return &_slots[head % _slots.size()];
+    }
+
+    // consumer: gives the slot returned by front() back to the producer
+    void pop()
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
@@ -0,0 +1,212 @@
+#include <algorithm>
+
+#include "task_pool.h"
+
+namespace
+{
+    // tasks one queue holds, a frame only submits one per video and a few per compose thread
+    const size_t queue_capacity = 256;
+}
+
+TaskPool::TaskPool(size_t thread_count)
+:
+_queued(0),
+_next_queue(0),
+_stop(false),
+_tasks_run(std::max(thread_count, (size_t)1)),
+_tasks_stolen(std::max(thread_count, (size_t)1))
+{
+    for (size_t i = 0; i < _tasks_run.size(); i++)
+    {
+        _queues.push_back(std::make_unique<TaskQueue>());
+        _queues.back()->tasks.resize(queue_capacity);
+    }
+
+    // queue 0 belongs to whichever thread calls wait()
+    for (size_t i = 1; i < size(); i++)
+    {
+        _threads.emplace_back(&TaskPool::worker, this, i);
+    }
+}
+
+void TaskPool::worker(size_t index)
+{
+    while (true)
+    {
+        if (try_run(index, nullptr))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _condition.wait(lock, [&]() { return _stop || _queued.load(std::memory_order_acquire) > 0; });
+
+        if (_stop) return;
+    }
+}
+
+bool TaskPool::take(TaskQueue& queue, const TaskGroup* group, bool newest, Task& task)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    const size_t capacity = queue.tasks.size();
+    const size_t count = queue.tail - queue.head;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t position = newest ? queue.tail - 1 - i : queue.head + i;
+
+        if (group && queue.tasks[position % capacity].group != group)
+        {
+            continue;
+        }
+
+        task = queue.tasks[position % capacity];
+
+        // close the gap by moving the tasks between it and the end taken from along by one
+        if (newest)
+        {
+            for (; position + 1 < queue.tail; position++)
+            {
+                queue.tasks[position % capacity] = queue.tasks[(position + 1) % capacity];
+            }
+
+            queue.tail--;
+        }
+        else
+        {
+            for (; position > queue.head; position--)
+            {
+                queue.tasks[position % capacity] = queue.tasks[(position - 1) % capacity];
+            }
+
+            queue.head++;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool TaskPool::try_run(size_t index, const TaskGroup* group)
+{
+    Task task;
+    bool stolen = false;
+
+    if (!take(*_queues[index], group, true, task))
+    {
+        // start with the next thread's queue, so thieves spread out instead of all going for queue 0
+        for (size_t i = 1; i < size() && !stolen; i++)
+        {
+            stolen = take(*_queues[(index + i) % size()], group, false, task);
+        }
+
+        if (!stolen)
+        {
+            return false;
+        }
+
+        _tasks_stolen[index]++;
+    }
+
+    _queued.fetch_sub(1, std::memory_order_relaxed);
+    task.group->queued.fetch_sub(1, std::memory_order_relaxed);
+
+    execute(index, task);
+
+    return true;
+}
+
+void TaskPool::execute(size_t index, const Task& task)
+{
+    task.invoke(task.context, task.index);
+
+    _tasks_run[index]++;
+
+    if (task.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        // taking the lock orders this with a waiter checking the group, so it can't miss the wakeup
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+        }
+
+        _condition.notify_all();
+    }
+}
+
+void TaskPool::submit_erased(TaskGroup& group, void (*invoke)(void* context, size_t index), void* context, size_t index)
+{
+    Task task = { invoke, context, index, &group };
+
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    group.queued.fetch_add(1, std::memory_order_relaxed);
+    _queued.fetch_add(1, std::memory_order_relaxed);
+
+    TaskQueue& queue = *_queues[_next_queue.fetch_add(1, std::memory_order_relaxed) % size()];
+    bool full;
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        full = queue.tail - queue.head == queue.tasks.size();
+
+        if (!full)
+        {
+            queue.tasks[queue.tail % queue.tasks.size()] = task;
+            queue.tail++;
+        }
+    }
+
+    // no room left, which only happens when far more is submitted than waited on, so run it right away
+    if (full)
+    {
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        group.queued.fetch_sub(1, std::memory_order_relaxed);
+
+        execute(0, task);
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+    }
+
+    _condition.notify_all();
+}
+
+void TaskPool::wait(TaskGroup& group)
+{
+    // without any worker threads nothing else would run the other groups' tasks
+    const TaskGroup* only = _threads.empty() ? nullptr : &group;
+
+    while (group.pending.load(std::memory_order_acquire) != 0)
+    {
+        if (try_run(0, only))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _condition.wait(lock, [&]() { return group.pending.load(std::memory_order_acquire) == 0 || group.queued.load(std::memory_order_relaxed) > 0; });
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stop = true;
+    }
+
+    _condition.notify_all();
+
+    for (std::thread& thread : _threads)
+    {
+        thread.join();
+    }
+}
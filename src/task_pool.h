@@ -0,0 +1,109 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+// Tasks submitted together which can be waited on together
+struct TaskGroup
+{
+    // submitted but not finished
+    std::atomic<size_t> pending{ 0 };
+
+    // submitted but not picked up by any thread yet
+    std::atomic<size_t> queued{ 0 };
+};
+
+// Shared pool of threads running independent tasks, eg. decoding several videos and composing
+// the frame they make up, so the number of videos doesn't decide the number of threads.
+//
+// Every thread has its own queue. Submitted tasks are dealt out between the queues, each thread
+// runs the newest task of its own queue first and, once that is empty, steals the oldest task
+// from another thread's queue, so a long task (eg. a keyframe) doesn't hold up the ones queued
+// behind it. The thread calling wait() takes queue 0 and helps with its group in the meantime.
+//
+// Tasks are kept as plain pointer pairs in preallocated rings, so submitting never allocates.
+class TaskPool
+{
+private:
+    struct Task
+    {
+        void (*invoke)(void* context, size_t index);
+        void* context;
+        size_t index;
+        TaskGroup* group;
+    };
+
+    // ring of tasks, the owner takes from the back and thieves from the front
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t head = 0;
+        size_t tail = 0;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> _queues;
+    std::vector<std::thread> _threads;
+
+    // sleeping threads and waiters are woken on the same condition, both when tasks are queued and when a group finishes
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::atomic<size_t> _queued;
+    std::atomic<size_t> _next_queue;
+    bool _stop;
+
+    // per thread statistics, each only written by its own thread
+    std::vector<size_t> _tasks_run;
+    std::vector<size_t> _tasks_stolen;
+
+    void worker(size_t index);
+
+    // runs a task from the thread's own queue or steals one from another, only one of group's unless it is null
+    // returns false when there was nothing to run
+    bool try_run(size_t index, const TaskGroup* group);
+
+    // removes the newest (or oldest) task in the queue, the newest (or oldest) of group's unless it is null
+    static bool take(TaskQueue& queue, const TaskGroup* group, bool newest, Task& task);
+
+    void execute(size_t index, const Task& task);
+    void submit_erased(TaskGroup& group, void (*invoke)(void* context, size_t index), void* context, size_t index);
+
+public:
+    // thread_count: threads taking part, including the one calling wait(), so 1 runs everything inside wait()
+    TaskPool(size_t thread_count);
+    TaskPool(const TaskPool&) = delete;
+
+    size_t size() const
+    {
+        return _queues.size();
+    }
+
+    // queues task(index) to run on any thread, task has to stay alive until wait() returns for the group
+    template <typename F>
+    void submit(TaskGroup& group, F& task, size_t index)
+    {
+        submit_erased(group, [](void* context, size_t index) { (*static_cast<F*>(context))(index); }, &task, index);
+    }
+
+    // waits for every task submitted to the group, running its tasks on the calling thread meanwhile
+    // it never picks up tasks of other groups, so waiting on a short group isn't held up by a long task
+    void wait(TaskGroup& group);
+
+    // tasks each thread ran, and how many of them it stole from another thread's queue
+    size_t tasks_run(size_t index) const
+    {
+        return _tasks_run[index];
+    }
+
+    size_t tasks_stolen(size_t index) const
+    {
+        return _tasks_stolen[index];
+    }
+
+    ~TaskPool();
+};
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "tiled_source.h"
+#include "trace.h"
+
+namespace
+{
+    // blank cells between neighbouring tiles, so the videos don't run into each other
+    const size_t tile_gutter = 1;
+
+    // grid rate when no video knows its own
+    const double fallback_framerate = 30.0;
+}
+
+TiledVideoSource::Tile::Tile(const char* filename, size_t levels, DitherMode dither)
+:
+filename(filename),
+quantizer(levels, dither),
+cell_x(0),
+cell_y(0),
+width(0),
+height(0),
+frame_duration(0),
+next_pts(0),
+has_frame(false),
+ended(false),
+frames_decoded(0)
+{
+}
+
+TiledVideoSource::TiledVideoSource(TaskPool& pool, size_t levels, DitherMode dither)
+:
+_pool(pool),
+_levels(levels),
+_front(0),
+_back(1),
+_decode_task{ this },
+_decoding(false),
+_frame_decoded(false),
+_frame_duration((int64_t)(1e9 / fallback_framerate)),
+_start_time(0),
+_target_pts(0),
+_frame_number(0),
+_dither(dither)
+{
+}
+
+std::optional<std::string> TiledVideoSource::open(const std::vector<const char*>& video_filenames, size_t width, size_t height, const DecoderOptions& decoder_options)
+{
+    // as square as the count allows, eg. 2x2 for 4 videos and 3x2 for 5 or 6
+    const size_t count = video_filenames.size();
+    const size_t columns = (size_t)std::ceil(std::sqrt((double)count));
+    const size_t rows = round_up_div(count, columns);
+
+    if (width < columns * (1 + tile_gutter) || height < rows * (1 + tile_gutter))
+    {
+        return "the " + std::to_string(width) + "x" + std::to_string(height) + " cell grid is too small for " + std::to_string(count) + " videos";
+    }
+
+    const size_t tile_width = (width - (columns - 1) * tile_gutter) / columns;
+    const size_t tile_height = (height - (rows - 1) * tile_gutter) / rows;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto tile = std::make_unique<Tile>(video_filenames[i], _levels, _dither);
+
+        tile->cell_x = (i % columns) * (tile_width + tile_gutter);
+        tile->cell_y = (i / columns) * (tile_height + tile_gutter);
+        tile->width = tile_width;
+        tile->height = tile_height;
+        tile->shades.emplace(tile_width * tile_height);
+        tile->indices.emplace(tile_width * tile_height);
+
+        _tiles.push_back(std::move(tile));
+    }
+
+    // probing is mostly waiting on I/O, so open every video at once
+    std::vector<std::optional<std::string>> errors(count);
+    TaskGroup opening;
+
+    auto open_tile = [&](size_t index) {
+        Tile& tile = *_tiles[index];
+
+        errors[index] = tile.player.open_video(tile.filename, tile.width, tile.height, decoder_options);
+    };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        _pool.submit(opening, open_tile, i);
+    }
+
+    _pool.wait(opening);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (errors[i])
+        {
+            return std::string(_tiles[i]->filename) + ": " + *errors[i];
+        }
+    }
+
+    double framerate = 0.0;
+
+    for (const auto& tile : _tiles)
+    {
+        framerate = std::max(framerate, tile->player.framerate());
+    }
+
+    if (framerate > 0.0)
+    {
+        _frame_duration = std::chrono::nanoseconds((int64_t)(1e9 / framerate));
+    }
+
+    // without a rate of its own, a video shows a new frame every time the grid does
+    for (const auto& tile : _tiles)
+    {
+        double tile_framerate = tile->player.framerate();
+
+        tile->frame_duration = tile_framerate > 0.0 ? std::chrono::nanoseconds((int64_t)(1e9 / tile_framerate)) : _frame_duration;
+    }
+
+    // cells outside every tile stay blank
+    for (size_t i = 0; i < 2; i++)
+    {
+        _plane_buffers[i].emplace(width * height);
+        _planes[i].emplace(_plane_buffers[i]->data(), width, height);
+
+        std::memset(_plane_buffers[i]->data(), (int)_levels, width * height);
+    }
+
+    return {};
+}
+
+std::optional<std::string> TiledVideoSource::seek(std::chrono::nanoseconds timestamp)
+{
+    for (const auto& tile : _tiles)
+    {
+        if (auto err = tile->player.seek(timestamp))
+        {
+            return std::string(tile->filename) + ": " + *err;
+        }
+    }
+
+    _start_time = timestamp;
+
+    return {};
+}
+
+void TiledVideoSource::set_looping(bool looping)
+{
+    for (const auto& tile : _tiles)
+    {
+        tile->player.set_looping(looping);
+    }
+}
+
+void TiledVideoSource::set_fast_scaling(bool fast_scaling)
+{
+    for (const auto& tile : _tiles)
+    {
+        tile->player.set_fast_scaling(fast_scaling);
+    }
+}
+
+bool TiledVideoSource::uses_swscale() const
+{
+    return std::any_of(_tiles.begin(), _tiles.end(), [](const std::unique_ptr<Tile>& tile) { return tile->player.uses_swscale(); });
+}
+
+void TiledVideoSource::decode_tile(size_t index)
+{
+    Tile& tile = *_tiles[index];
+    bool decoded = false;
+
+    // a slower video holds its frame, one which fell behind (eg. on a keyframe) catches up without scaling being skipped
+    while (!tile.ended && (!tile.has_frame || tile.next_pts <= _target_pts))
+    {
+        if (!tile.player.get_next_frame(tile.shades->data()))
+        {
+            tile.ended = true;
+
+            break;
+        }
+
+        tile.next_pts = tile.player.frame_time() + tile.frame_duration;
+        tile.has_frame = true;
+        tile.frames_decoded++;
+        decoded = true;
+    }
+
+    if (!tile.has_frame)
+    {
+        return;
+    }
+
+    if (decoded)
+    {
+        ImageBuffer<uint8_t> shades(tile.shades->data(), tile.width, tile.height);
+        ImageBuffer<uint8_t> indices(tile.indices->data(), tile.width, tile.height);
+
+        TRACE_CALL(Quantize, tile.quantizer.quantize(shades, indices));
+
+        _frame_decoded.store(true, std::memory_order_relaxed);
+    }
+
+    // the planes take turns, so the tile is copied even when it didn't change
+    ImageBuffer<uint8_t>& plane = *_planes[_back];
+
+    for (size_t y = 0; y < tile.height; y++)
+    {
+        std::memcpy(plane.pixels + (tile.cell_y + y) * plane.width + tile.cell_x, tile.indices->data() + y * tile.width, tile.width);
+    }
+}
+
+void TiledVideoSource::submit_frame()
+{
+    for (const auto& tile : _tiles)
+    {
+        tile->quantizer.set_dither(_dither);
+    }
+
+    _target_pts = _start_time + _frame_duration * (int64_t)_frame_number;
+    _frame_decoded.store(false, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < _tiles.size(); i++)
+    {
+        _pool.submit(_decode_group, _decode_task, i);
+    }
+
+    _decoding = true;
+}
+
+bool TiledVideoSource::next_frame(std::chrono::nanoseconds& pts)
+{
+    if (!_decoding)
+    {
+        submit_frame();
+    }
+
+    TRACE_CALL(WaitForDecoder, _pool.wait(_decode_group));
+    _decoding = false;
+
+    // every video has ended and shown its last frame
+    if (!_frame_decoded.load(std::memory_order_relaxed))
+    {
+        bool ended = std::all_of(_tiles.begin(), _tiles.end(), [](const std::unique_ptr<Tile>& tile) { return tile->ended; });
+
+        if (ended)
+        {
+            return false;
+        }
+    }
+
+    pts = _target_pts;
+    std::swap(_front, _back);
+    _frame_number++;
+
+    // decode the next frame into the other plane while this one is composed
+    submit_frame();
+
+    return true;
+}
+
+TiledVideoSource::~TiledVideoSource()
+{
+    if (_decoding)
+    {
+        _pool.wait(_decode_group);
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "frame_source.h"
+#include "video_player.h"
+#include "quantize.h"
+#include "task_pool.h"
+#include "aligned_buffer.h"
+
+// Plays several videos at once, each in its own tile of one cell grid (eg. a 2x2 dashboard).
+//
+// Every tile has its own player and quantizer, but no thread: each frame, decoding, scaling and
+// quantizing every tile is one task per tile on a shared TaskPool, which the compositor also
+// composes on, so the number of videos doesn't decide the number of threads. The next frame's
+// tiles are decoded into a second plane while the current one is composed.
+//
+// Tiles keep to their own video's framerate. The grid advances at the fastest one, and slower
+// videos hold their frame until the next is due. Videos which end early keep showing their last frame.
+class TiledVideoSource : public FrameSource
+{
+private:
+    struct Tile
+    {
+        const char* filename;
+        VideoPlayer player;
+        ShadeQuantizer quantizer;
+
+        // where the tile's cells start in the plane, and how many it covers
+        size_t cell_x, cell_y;
+        size_t width, height;
+
+        // the last decoded frame, scaled to the tile and quantized
+        std::optional<AlignedBuffer<uint8_t>> shades;
+        std::optional<AlignedBuffer<uint8_t>> indices;
+
+        std::chrono::nanoseconds frame_duration;
+
+        // stream time the frame after the one held is due
+        std::chrono::nanoseconds next_pts;
+        bool has_frame;
+        bool ended;
+        size_t frames_decoded;
+
+        Tile(const char* filename, size_t levels, DitherMode dither);
+    };
+
+    // lets the pool run decode_tile() without a lambda which would have to outlive next_frame()
+    struct DecodeTask
+    {
+        TiledVideoSource* source;
+
+        void operator()(size_t tile)
+        {
+            source->decode_tile(tile);
+        }
+    };
+
+    TaskPool& _pool;
+    size_t _levels;
+    std::vector<std::unique_ptr<Tile>> _tiles;
+
+    // the plane being composed and the one the next frame's tiles are decoded into
+    std::optional<AlignedBuffer<uint8_t>> _plane_buffers[2];
+    std::optional<ImageBuffer<uint8_t>> _planes[2];
+    size_t _front;
+    size_t _back;
+
+    DecodeTask _decode_task;
+    TaskGroup _decode_group;
+    bool _decoding;
+
+    // set by a tile task which decoded a new frame, the grid has ended once none do and every tile has ended
+    std::atomic<bool> _frame_decoded;
+
+    std::chrono::nanoseconds _frame_duration;
+    std::chrono::nanoseconds _start_time;
+    std::chrono::nanoseconds _target_pts;
+    size_t _frame_number;
+
+    // applied to the quantizers between frames, never while their tasks run
+    DitherMode _dither;
+
+    // decodes the tile up to _target_pts and copies it into the back plane
+    void decode_tile(size_t index);
+
+    // queues the tiles of the next frame on the pool
+    void submit_frame();
+
+public:
+    // pool: shared with the compositor, has to outlive the source
+    // levels: number of cursor shades, which is also the index of a blank cell between the tiles
+    TiledVideoSource(TaskPool& pool, size_t levels, DitherMode dither);
+    TiledVideoSource(const TiledVideoSource&) = delete;
+
+    // lays the videos out in rows of tiles over a width x height cell grid, and opens them all at once on the pool
+    std::optional<std::string> open(const std::vector<const char*>& video_filenames, size_t width, size_t height, const DecoderOptions& decoder_options);
+
+    // the fastest video's rate, which the grid advances at
+    double framerate() const override
+    {
+        return 1e9 / _frame_duration.count();
+    }
+
+    // seeks every video
+    std::optional<std::string> seek(std::chrono::nanoseconds timestamp) override;
+
+    void set_looping(bool looping) override;
+
+    bool next_frame(std::chrono::nanoseconds& pts) override;
+
+    const ImageBuffer<uint8_t>& frame_indices() override
+    {
+        return *_planes[_front];
+    }
+
+    // takes effect from the frame after next, which is the first not already being decoded
+    void set_dither(DitherMode dither)
+    {
+        _dither = dither;
+    }
+
+    void set_fast_scaling(bool fast_scaling);
+
+    // any of the videos goes through swscale, see VideoPlayer::uses_swscale()
+    bool uses_swscale() const;
+
+    size_t tile_count() const
+    {
+        return _tiles.size();
+    }
+
+    const char* tile_filename(size_t index) const
+    {
+        return _tiles[index]->filename;
+    }
+
+    const VideoPlayer& tile_player(size_t index) const
+    {
+        return _tiles[index]->player;
+    }
+
+    // frames decoded for the tile so far, including ones decoded only to catch up with the grid
+    size_t tile_frames_decoded(size_t index) const
+    {
+        return _tiles[index]->frames_decoded;
+    }
+
+    // waits for the frame still being decoded, its tasks point into the source
+    ~TiledVideoSource();
+};
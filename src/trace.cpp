@@ -0,0 +1,194 @@
+#ifdef CURSOR_VIDEO_TRACE
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <time.h>
+
+#include "trace.h"
+
+namespace
+{
+    struct TraceEvent
+    {
+        int64_t start_ns;
+        int64_t duration_ns;
+        uint32_t thread;
+        TraceStage stage;
+    };
+
+    // per thread, a power of two so the slot is a mask instead of a division, about 1.5MB
+    const size_t trace_capacity = 1 << 16;
+
+    // every thread records into its own ring, so recording never takes a lock
+    // and two threads can never write the same slot
+    struct TraceRing
+    {
+        uint32_t thread;
+        std::atomic<uint64_t> next_event;
+        std::unique_ptr<TraceEvent[]> events;
+    };
+
+    // rings outlive their threads, so the decoder's events are still there at exit
+    std::mutex trace_rings_mutex;
+    std::vector<std::unique_ptr<TraceRing>> trace_rings;
+
+    // allocated the first time a thread records, not on every event
+    TraceRing* create_ring()
+    {
+        std::lock_guard<std::mutex> lock(trace_rings_mutex);
+
+        trace_rings.push_back(std::unique_ptr<TraceRing>(new TraceRing { (uint32_t)trace_rings.size(), { 0 }, std::unique_ptr<TraceEvent[]>(new TraceEvent[trace_capacity]) }));
+
+        return trace_rings.back().get();
+    }
+
+    const char* const stage_names[] = {
+        "read_packet",
+        "send_packet",
+        "receive_frame",
+        "scale",
+        "wait_for_decoder",
+        "quantize",
+        "apply_cell_stream",
+        "compose",
+        "compose_band",
+        "wait_for_deadline",
+        "present",
+        "wait_for_buffer",
+        "convert_frame",
+        "encode"
+    };
+
+    static_assert(sizeof(stage_names) / sizeof(stage_names[0]) == (size_t)TraceStage::Count, "every stage needs a name");
+
+    // the events still held by every ring, oldest first, and how many were overwritten
+    std::vector<TraceEvent> recorded_events(uint64_t& overwritten)
+    {
+        std::lock_guard<std::mutex> lock(trace_rings_mutex);
+        std::vector<TraceEvent> events;
+
+        overwritten = 0;
+
+        for (const std::unique_ptr<TraceRing>& ring : trace_rings)
+        {
+            uint64_t end = ring->next_event.load(std::memory_order_acquire);
+            uint64_t begin = end > trace_capacity ? end - trace_capacity : 0;
+
+            overwritten += begin;
+
+            for (uint64_t i = begin; i < end; i++)
+            {
+                events.push_back(ring->events[i & (trace_capacity - 1)]);
+            }
+        }
+
+        std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.start_ns < b.start_ns; });
+
+        return events;
+    }
+}
+
+const char* trace_stage_name(TraceStage stage)
+{
+    return stage_names[(size_t)stage];
+}
+
+int64_t trace_now_ns()
+{
+    timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void trace_record(TraceStage stage, int64_t start_ns, int64_t end_ns)
+{
+    thread_local TraceRing* ring = create_ring();
+
+    uint64_t index = ring->next_event.load(std::memory_order_relaxed);
+
+    ring->events[index & (trace_capacity - 1)] = { start_ns, end_ns - start_ns, ring->thread, stage };
+    ring->next_event.store(index + 1, std::memory_order_release);
+}
+
+void trace_print_summary(FILE* file)
+{
+    uint64_t overwritten;
+    std::vector<TraceEvent> events = recorded_events(overwritten);
+
+    std::fprintf(file, "trace: %zu events", events.size());
+
+    if (overwritten)
+    {
+        std::fprintf(file, " (the oldest %llu were overwritten)", (unsigned long long)overwritten);
+    }
+
+    std::fprintf(file, "\n%-18s %8s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean ms", "p50 ms", "p90 ms", "p99 ms", "p99.9 ms", "max ms");
+
+    std::vector<int64_t> durations;
+
+    for (size_t stage = 0; stage < (size_t)TraceStage::Count; stage++)
+    {
+        durations.clear();
+
+        for (const TraceEvent& event : events)
+        {
+            if ((size_t)event.stage == stage) durations.push_back(event.duration_ns);
+        }
+
+        if (durations.empty()) continue;
+
+        std::sort(durations.begin(), durations.end());
+
+        double sum = 0;
+
+        for (int64_t duration : durations) sum += duration;
+
+        auto percentile = [&](double p) {
+            return durations[std::min(durations.size() - 1, (size_t)(p * durations.size()))] / 1e6;
+        };
+
+        std::fprintf(file, "%-18s %8zu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", stage_names[stage], durations.size(), sum / durations.size() / 1e6,
+                     percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), durations.back() / 1e6);
+    }
+}
+
+std::optional<std::string> trace_write_chrome(const std::string& filename)
+{
+    FILE* file = std::fopen(filename.c_str(), "w");
+
+    if (!file)
+    {
+        return "could not write " + filename;
+    }
+
+    uint64_t overwritten;
+    std::vector<TraceEvent> events = recorded_events(overwritten);
+    int64_t origin = events.empty() ? 0 : events.front().start_ns;
+
+    std::fprintf(file, "{\"traceEvents\": [\n");
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const TraceEvent& event = events[i];
+
+        // complete events, timestamps in microseconds
+        std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}%s\n", stage_names[(size_t)event.stage],
+                     event.thread, (event.start_ns - origin) / 1e3, event.duration_ns / 1e3, i + 1 < events.size() ? "," : "");
+    }
+
+    std::fprintf(file, "]}\n");
+
+    if (std::fclose(file) != 0)
+    {
+        return "could not write " + filename;
+    }
+
+    return {};
+}
+
+#endif
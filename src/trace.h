@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <cstdio>
+#include <cstdint>
+
+// Stages of the pipeline which are timed when tracing is compiled in
+enum class TraceStage : uint8_t
+{
+    ReadPacket,      // av_read_frame
+    SendPacket,      // avcodec_send_packet
+    ReceiveFrame,    // avcodec_receive_frame
+    Scale,           // sws_scale
+    WaitForDecoder,  // the render loop waiting on the decode ring
+    Quantize,
+    ApplyCellStream, // decoding a precompiled frame
+    Compose,         // write_frame
+    ComposeBand,     // one thread's band of write_frame
+    WaitForDeadline,
+    Present,
+    WaitForBuffer,   // waiting for the X server to release a shared memory buffer
+    ConvertFrame,    // backbuffer to the encoder's pixel format, when rendering to a file
+    Encode,          // avcodec_send_frame and receiving its packets
+    Count
+};
+
+// Tracing is only compiled in with -DCURSOR_VIDEO_TRACE (make TRACE=1),
+// otherwise every TRACE_ macro expands to nothing.
+//
+// TRACE_SCOPE(Stage);             times the rest of the enclosing block
+// TRACE_CALL(Stage, expression)   times an expression and gives its value
+#ifdef CURSOR_VIDEO_TRACE
+
+const char* trace_stage_name(TraceStage stage);
+
+int64_t trace_now_ns();
+
+// stores one event into the trace ring, overwriting the oldest once it is full
+// safe to call from any thread
+void trace_record(TraceStage stage, int64_t start_ns, int64_t end_ns);
+
+// prints latency percentiles for each stage over the events still in the ring
+void trace_print_summary(FILE* file);
+
+// writes the events in the ring as Chrome trace events, for chrome://tracing or Perfetto
+std::optional<std::string> trace_write_chrome(const std::string& filename);
+
+class TraceScope
+{
+private:
+    TraceStage _stage;
+    int64_t _start_ns;
+
+public:
+    TraceScope(TraceStage stage)
+    :
+    _stage(stage),
+    _start_ns(trace_now_ns())
+    {
+    }
+
+    TraceScope(const TraceScope&) = delete;
+
+    ~TraceScope()
+    {
+        trace_record(_stage, _start_ns, trace_now_ns());
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(stage) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(TraceStage::stage)
+#define TRACE_CALL(stage, expression) ([&]() { TRACE_SCOPE(stage); return (expression); }())
+
+#else
+
+#define TRACE_SCOPE(stage) ((void)0)
+#define TRACE_CALL(stage, expression) (expression)
+
+#endif
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "video_encoder.h"
+#include "trace.h"
+
+extern "C" {
+    #include <libswscale/swscale.h>
+}
+
+namespace
+{
+    std::string error_string(int error)
+    {
+        char err_str[AV_ERROR_MAX_STRING_SIZE];
+
+        av_make_error_string(err_str, AV_ERROR_MAX_STRING_SIZE, error);
+
+        return err_str;
+    }
+}
+
+VideoEncoder::VideoEncoder()
+:
+_codec_context(nullptr),
+_sws_context(nullptr)
+{
+}
+
+std::optional<std::string> VideoEncoder::open(const AVOutputFormat* format, size_t width, size_t height, AVRational frame_rate, const EncoderOptions& options)
+{
+    const AVCodec* codec = nullptr;
+
+    if (!options.codec_name.empty())
+    {
+        codec = avcodec_find_encoder_by_name(options.codec_name.c_str());
+
+        if (!codec)
+        {
+            return "no encoder called '" + options.codec_name + "'";
+        }
+    }
+    else
+    {
+        // the container's usual codec, or MPEG-4 part 2, which is built into every ffmpeg
+        codec = format->video_codec != AV_CODEC_ID_NONE ? avcodec_find_encoder(format->video_codec) : nullptr;
+
+        if (!codec) codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+
+        if (!codec)
+        {
+            return std::string("no video encoder found for ") + format->name;
+        }
+    }
+
+    _codec_context = avcodec_alloc_context3(codec);
+
+    if (!_codec_context)
+    {
+        return "could not create an encoder context";
+    }
+
+    double framerate = av_q2d(frame_rate);
+
+    _codec_context->width = (int)width;
+    _codec_context->height = (int)height;
+    _codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    _codec_context->time_base = av_inv_q(frame_rate);
+    _codec_context->framerate = frame_rate;
+    _codec_context->thread_count = options.thread_count;
+
+    // a keyframe every two seconds, so the output can be seeked
+    _codec_context->gop_size = std::max((int)std::lround(framerate * 2), 1);
+
+    // about 8Mbit/s at 1080p30, plenty for flat cursor cells
+    _codec_context->bit_rate = options.bit_rate ? options.bit_rate : (int64_t)(width * height * framerate / 8);
+
+    if (!options.b_frames)
+    {
+        _codec_context->max_b_frames = 0;
+    }
+
+    if (format->flags & AVFMT_GLOBALHEADER)
+    {
+        _codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    int res = avcodec_open2(_codec_context, codec, nullptr);
+
+    if (res < 0)
+    {
+        return std::string("could not open the ") + codec->name + " encoder for " + std::to_string(width) + "x" + std::to_string(height) + " yuv420p: " + error_string(res);
+    }
+
+    // the composited frame is BGRA in memory, with the alpha left at 0 once it is opaque
+    _opaque.emplace(width * height);
+    _sws_context = sws_getContext((int)width, (int)height, AV_PIX_FMT_BGR0, (int)width, (int)height, _codec_context->pix_fmt,
+                                  SWS_BILINEAR, nullptr, nullptr, nullptr);
+
+    if (!_sws_context)
+    {
+        return "could not create the colour converter";
+    }
+
+    return {};
+}
+
+AVFrame* VideoEncoder::allocate_frame() const
+{
+    AVFrame* frame = av_frame_alloc();
+
+    if (!frame)
+    {
+        return nullptr;
+    }
+
+    frame->format = _codec_context->pix_fmt;
+    frame->width = _codec_context->width;
+    frame->height = _codec_context->height;
+
+    if (av_frame_get_buffer(frame, 0) < 0)
+    {
+        av_frame_free(&frame);
+    }
+
+    return frame;
+}
+
+std::optional<std::string> VideoEncoder::convert(const ImageBuffer<uint32_t>& image, AVFrame* frame)
+{
+    TRACE_SCOPE(ConvertFrame);
+
+    if (av_frame_make_writable(frame) < 0)
+    {
+        return "could not allocate a frame to encode";
+    }
+
+    const size_t pixel_count = image.width * image.height;
+    const uint32_t* pixels = image.pixels;
+    uint32_t* opaque = _opaque->data();
+
+    // cursor pixels are premultiplied, so compositing over white just adds the missing coverage to each channel,
+    // which can never carry into the next one
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        uint32_t pixel = pixels[i];
+        uint32_t background = 255 - (pixel >> 24);
+
+        opaque[i] = (pixel & 0xffffff) + background * 0x010101;
+    }
+
+    const uint8_t* source[] = { (const uint8_t*)opaque };
+    const int source_stride[] = { (int)(image.width * sizeof(uint32_t)) };
+
+    sws_scale(_sws_context, source, source_stride, 0, (int)image.height, frame->data, frame->linesize);
+
+    return {};
+}
+
+std::optional<std::string> VideoEncoder::encode(const AVFrame* frame, std::vector<AVPacket*>& packets)
+{
+    TRACE_SCOPE(Encode);
+
+    int res = avcodec_send_frame(_codec_context, frame);
+
+    if (res < 0)
+    {
+        return "could not send a frame to the encoder: " + error_string(res);
+    }
+
+    while (true)
+    {
+        AVPacket* packet = av_packet_alloc();
+
+        if (!packet)
+        {
+            return "could not allocate a packet";
+        }
+
+        res = avcodec_receive_packet(_codec_context, packet);
+
+        if (res < 0)
+        {
+            av_packet_free(&packet);
+
+            if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
+            {
+                return {};
+            }
+
+            return "encoding failed: " + error_string(res);
+        }
+
+        packets.push_back(packet);
+    }
+}
+
+std::string VideoEncoder::description() const
+{
+    char description[128];
+
+    std::snprintf(description, sizeof(description), "%s, yuv420p, %.1fMbit/s", _codec_context->codec->name, _codec_context->bit_rate / 1e6);
+
+    return description;
+}
+
+VideoEncoder::~VideoEncoder()
+{
+    sws_freeContext(_sws_context);
+    avcodec_free_context(&_codec_context);
+}
+
+VideoMuxer::VideoMuxer()
+:
+_format_context(nullptr),
+_stream(nullptr),
+_header_written(false)
+{
+}
+
+std::optional<std::string> VideoMuxer::open(const std::string& filename)
+{
+    _filename = filename;
+
+    if (avformat_alloc_output_context2(&_format_context, nullptr, nullptr, filename.c_str()) < 0 || !_format_context)
+    {
+        return "could not tell which container to write from the name " + filename + ", try eg. .mp4 or .mkv";
+    }
+
+    return {};
+}
+
+std::optional<std::string> VideoMuxer::write_header(const VideoEncoder& encoder)
+{
+    _stream = avformat_new_stream(_format_context, nullptr);
+
+    if (!_stream || avcodec_parameters_from_context(_stream->codecpar, encoder.codec_context()) < 0)
+    {
+        return "could not add the video stream to " + _filename;
+    }
+
+    // only a hint, the muxer picks the final time base in avformat_write_header()
+    _stream->time_base = encoder.time_base();
+
+    if (!(_format_context->oformat->flags & AVFMT_NOFILE) && avio_open(&_format_context->pb, _filename.c_str(), AVIO_FLAG_WRITE) < 0)
+    {
+        return "could not open " + _filename + " for writing";
+    }
+
+    int res = avformat_write_header(_format_context, nullptr);
+
+    if (res < 0)
+    {
+        return "could not write the header of " + _filename + ": " + error_string(res);
+    }
+
+    _header_written = true;
+
+    return {};
+}
+
+std::optional<std::string> VideoMuxer::write(AVPacket* packet, AVRational time_base)
+{
+    av_packet_rescale_ts(packet, time_base, _stream->time_base);
+    packet->stream_index = _stream->index;
+
+    int res = av_interleaved_write_frame(_format_context, packet);
+
+    if (res < 0)
+    {
+        return "could not write to " + _filename + ": " + error_string(res);
+    }
+
+    return {};
+}
+
+std::optional<std::string> VideoMuxer::finish()
+{
+    int res = av_write_trailer(_format_context);
+
+    _header_written = false;
+
+    if (res < 0)
+    {
+        return "could not finish " + _filename + ": " + error_string(res);
+    }
+
+    return {};
+}
+
+VideoMuxer::~VideoMuxer()
+{
+    if (!_format_context) return;
+
+    // an unfinished file is still closed properly, so whatever was written can be played
+    if (_header_written) av_write_trailer(_format_context);
+    if (_format_context->pb && !(_format_context->oformat->flags & AVFMT_NOFILE)) avio_closep(&_format_context->pb);
+
+    avformat_free_context(_format_context);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <cstdint>
+
+#include "misc.h"
+#include "aligned_buffer.h"
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+}
+
+struct EncoderOptions
+{
+    // libavcodec encoder, eg. "libx264", empty picks the output format's default
+    std::string codec_name;
+
+    // bits per second, 0 picks one from the frame size and rate
+    int64_t bit_rate = 0;
+
+    // B-frames make decode timestamps run behind presentation ones, which breaks where encoded segments are joined
+    bool b_frames = true;
+
+    // 0 picks one thread per core
+    int thread_count = 0;
+};
+
+// Turns composited backbuffers into compressed packets with libavcodec.
+// The frame is composited over white first, the way the overlay looks on a light desktop,
+// so blank cells stay the brightest part of the picture.
+class VideoEncoder
+{
+private:
+    AVCodecContext* _codec_context;
+    struct SwsContext* _sws_context;
+
+    // the backbuffer composited over white, what swscale converts
+    std::optional<AlignedBuffer<uint32_t>> _opaque;
+
+public:
+    VideoEncoder();
+    VideoEncoder(const VideoEncoder&) = delete;
+
+    // format: the muxer the packets go to, whose default codec is used unless options name one
+    // width, height: even, as most pixel formats encoders take share colour between pairs of pixels
+    std::optional<std::string> open(const AVOutputFormat* format, size_t width, size_t height, AVRational frame_rate, const EncoderOptions& options);
+
+    // a frame in the encoder's format and size to convert() into, free it with av_frame_free()
+    AVFrame* allocate_frame() const;
+
+    // composites the backbuffer's premultiplied ARGB over white and converts it into frame
+    // frame is made writable first, so its old buffers can stay with the encoder if it still holds on to them
+    std::optional<std::string> convert(const ImageBuffer<uint32_t>& image, AVFrame* frame);
+
+    // sends frame, null to flush the encoder at the end, and appends every packet it hands back
+    // packets are in time_base() and belong to the caller, free them with av_packet_free()
+    std::optional<std::string> encode(const AVFrame* frame, std::vector<AVPacket*>& packets);
+
+    const AVCodecContext* codec_context() const
+    {
+        return _codec_context;
+    }
+
+    // of the frames' pts and the packets' timestamps, one frame per tick
+    AVRational time_base() const
+    {
+        return _codec_context->time_base;
+    }
+
+    // eg. "libx264, yuv420p, 8.0Mbit/s"
+    std::string description() const;
+
+    ~VideoEncoder();
+};
+
+// Writes encoded packets into a container file, picked from the file name's extension
+class VideoMuxer
+{
+private:
+    AVFormatContext* _format_context;
+    AVStream* _stream;
+    std::string _filename;
+    bool _header_written;
+
+public:
+    VideoMuxer();
+    VideoMuxer(const VideoMuxer&) = delete;
+
+    std::optional<std::string> open(const std::string& filename);
+
+    // for VideoEncoder::open()
+    const AVOutputFormat* format() const
+    {
+        return _format_context->oformat;
+    }
+
+    // adds the video stream with the encoder's parameters and opens the file
+    std::optional<std::string> write_header(const VideoEncoder& encoder);
+
+    // writes a packet from an encoder with the given time base
+    std::optional<std::string> write(AVPacket* packet, AVRational time_base);
+
+    // writes the index and closes the file
+    std::optional<std::string> finish();
+
+    ~VideoMuxer();
+};
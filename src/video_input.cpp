@@ -0,0 +1,276 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+#include "video_input.h"
+
+namespace
+{
+    // how much libav asks for per read, pipes and sockets hand back whatever has arrived so it adds no delay
+    const int io_buffer_size = 64 * 1024;
+}
+
+VideoInput::VideoInput()
+:
+_kind(Kind::Libav),
+_data(nullptr),
+_size(0),
+_position(0),
+_fd(-1),
+_owns_fd(false),
+_avio(nullptr)
+{
+}
+
+std::optional<std::string> VideoInput::open(const char* filename, const InputOptions& options, AVFormatContext* format_context)
+{
+    std::optional<std::string> err;
+    struct stat file_stat;
+
+    if (std::strcmp(filename, "-") == 0)
+    {
+        _fd = STDIN_FILENO;
+        _kind = Kind::Stream;
+    }
+    else if (stat(filename, &file_stat) != 0)
+    {
+        // not a local file, eg. a URL, which libav opens itself
+        return {};
+    }
+    else if (S_ISFIFO(file_stat.st_mode) || S_ISCHR(file_stat.st_mode) || S_ISSOCK(file_stat.st_mode))
+    {
+        err = open_stream(filename, S_ISSOCK(file_stat.st_mode));
+    }
+    else if (S_ISREG(file_stat.st_mode) && options.map_files && file_stat.st_size > 0)
+    {
+        err = map_file(filename);
+    }
+    else
+    {
+        return {};
+    }
+
+    if (err)
+    {
+        return err;
+    }
+
+    uint8_t* buffer = (uint8_t*)av_malloc(io_buffer_size);
+
+    if (!buffer)
+    {
+        return "could not allocate an I/O buffer";
+    }
+
+    if (_kind == Kind::Mapped)
+    {
+        _avio = avio_alloc_context(buffer, io_buffer_size, 0, this, read_mapped, nullptr, seek_mapped);
+    }
+    else
+    {
+        _avio = avio_alloc_context(buffer, io_buffer_size, 0, this, read_stream, nullptr, nullptr);
+    }
+
+    if (!_avio)
+    {
+        av_free(buffer);
+
+        return "could not create an I/O context";
+    }
+
+    format_context->pb = _avio;
+    format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    if (_kind == Kind::Stream)
+    {
+        // a live stream can't be rewound, so the probe only gets to look at what arrives first
+        _avio->seekable = 0;
+
+        format_context->probesize = options.probe_size ? options.probe_size : stream_probe_size;
+        format_context->max_analyze_duration = (options.analyze_duration.count() ? options.analyze_duration : stream_analyze_duration).count();
+
+        if (options.no_buffer)
+        {
+            format_context->flags |= AVFMT_FLAG_NOBUFFER;
+        }
+    }
+
+    return {};
+}
+
+std::optional<std::string> VideoInput::map_file(const char* filename)
+{
+    int fd = ::open(filename, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return std::string("could not open ") + filename;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+
+        return std::string("could not open ") + filename;
+    }
+
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return std::string("could not map ") + filename;
+    }
+
+    _data = (const uint8_t*)data;
+    _size = file_stat.st_size;
+    _kind = Kind::Mapped;
+
+    // demuxing mostly reads straight through, so let the kernel read ahead further
+    madvise(data, _size, MADV_SEQUENTIAL);
+
+    return {};
+}
+
+std::optional<std::string> VideoInput::open_stream(const char* filename, bool is_socket)
+{
+    if (is_socket)
+    {
+        sockaddr_un address = {};
+
+        if (std::strlen(filename) >= sizeof(address.sun_path))
+        {
+            return std::string("socket path is too long: ") + filename;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, filename);
+
+        _fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (_fd >= 0 && connect(_fd, (const sockaddr*)&address, sizeof(address)) != 0)
+        {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+    else
+    {
+        // opening a FIFO blocks until something opens the other end, which is what we want to wait for anyway
+        _fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+    }
+
+    if (_fd < 0)
+    {
+        return std::string(is_socket ? "could not connect to " : "could not open ") + filename + ": " + std::strerror(errno);
+    }
+
+    _owns_fd = true;
+    _kind = Kind::Stream;
+
+    return {};
+}
+
+int VideoInput::read_mapped(void* opaque, uint8_t* buffer, int size)
+{
+    VideoInput& input = *static_cast<VideoInput*>(opaque);
+    size_t bytes = std::min((size_t)size, input._size - input._position);
+
+    if (bytes == 0)
+    {
+        return AVERROR_EOF;
+    }
+
+    // page faults instead of read() calls, and the pages stay cached in our address space for loops and seeks
+    std::memcpy(buffer, input._data + input._position, bytes);
+    input._position += bytes;
+
+    return (int)bytes;
+}
+
+int64_t VideoInput::seek_mapped(void* opaque, int64_t offset, int whence)
+{
+    VideoInput& input = *static_cast<VideoInput*>(opaque);
+    int64_t position = 0;
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE: return (int64_t)input._size;
+        case SEEK_SET: position = offset; break;
+        case SEEK_CUR: position = (int64_t)input._position + offset; break;
+        case SEEK_END: position = (int64_t)input._size + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+
+    if (position < 0 || position > (int64_t)input._size)
+    {
+        return AVERROR(EINVAL);
+    }
+
+    input._position = (size_t)position;
+
+    return position;
+}
+
+int VideoInput::read_stream(void* opaque, uint8_t* buffer, int size)
+{
+    VideoInput& input = *static_cast<VideoInput*>(opaque);
+
+    while (true)
+    {
+        ssize_t bytes = read(input._fd, buffer, size);
+
+        if (bytes > 0)
+        {
+            return (int)bytes;
+        }
+        else if (bytes == 0)
+        {
+            return AVERROR_EOF;
+        }
+        else if (errno != EINTR)
+        {
+            return AVERROR(errno);
+        }
+    }
+}
+
+std::string VideoInput::description() const
+{
+    char description[64];
+
+    switch (_kind)
+    {
+        case Kind::Mapped:
+            std::snprintf(description, sizeof(description), "memory mapped file, %.1fMB", _size / (1024.0 * 1024.0));
+
+            return description;
+        case Kind::Stream:
+            return _fd == STDIN_FILENO ? "stream from stdin" : "stream";
+        default:
+            return "libav I/O";
+    }
+}
+
+VideoInput::~VideoInput()
+{
+    if (_avio)
+    {
+        av_freep(&_avio->buffer);
+        avio_context_free(&_avio);
+    }
+
+    if (_data) munmap((void*)_data, _size);
+    if (_owns_fd) close(_fd);
+}
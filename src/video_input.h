@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+struct InputOptions
+{
+    // demux regular files straight out of a memory mapping instead of libav's buffered reads
+    bool map_files = true;
+
+    // pipes, sockets and stdin: bytes and stream time avformat_find_stream_info may read before playback starts
+    // 0 uses stream_probe_size and stream_analyze_duration, files always keep libav's defaults
+    size_t probe_size = 0;
+    std::chrono::microseconds analyze_duration{ 0 };
+
+    // pipes, sockets and stdin: stop the demuxer buffering packets ahead of the decoder
+    bool no_buffer = true;
+};
+
+// libav's defaults (5MB and 5s) are there to get every stream's parameters right, which can stall a live pipe for seconds
+constexpr size_t stream_probe_size = 32 * 1024;
+constexpr std::chrono::microseconds stream_analyze_duration{ 200000 };
+
+// Where the demuxer reads the video from, picked from the file name:
+// "-" is stdin, FIFOs and character devices are read as streams, UNIX sockets are
+// connected to and read as streams, regular files are memory mapped, and anything
+// else (eg. URLs) is left to libav.
+class VideoInput
+{
+public:
+    enum class Kind
+    {
+        Libav,  // avformat_open_input does its own I/O
+        Mapped, // a memory mapped regular file, seekable
+        Stream  // stdin, a FIFO or a socket, read as it arrives and not seekable
+    };
+
+private:
+    Kind _kind;
+
+    // Mapped
+    const uint8_t* _data;
+    size_t _size;
+    size_t _position;
+
+    // Stream
+    int _fd;
+    bool _owns_fd;
+
+    AVIOContext* _avio;
+
+    static int read_mapped(void* opaque, uint8_t* buffer, int size);
+    static int64_t seek_mapped(void* opaque, int64_t offset, int whence);
+    static int read_stream(void* opaque, uint8_t* buffer, int size);
+
+    std::optional<std::string> map_file(const char* filename);
+    std::optional<std::string> open_stream(const char* filename, bool is_socket);
+
+public:
+    VideoInput();
+    VideoInput(const VideoInput&) = delete;
+
+    // opens the input and, for mapped files and streams, gives format_context a custom AVIOContext reading it
+    // format_context: allocated but not yet opened, avformat_open_input() must be given the same file name
+    std::optional<std::string> open(const char* filename, const InputOptions& options, AVFormatContext* format_context);
+
+    Kind kind() const
+    {
+        return _kind;
+    }
+
+    // eg. "memory mapped file, 12.3MB"
+    std::string description() const;
+
+    // the custom AVIOContext is freed here, it has to outlive the format context using it
+    ~VideoInput();
+};
@@ -1,6 +1,8 @@
 #include <iostream>
+#include <algorithm>
 
 #include "video_player.h"
+#include "trace.h"
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -11,8 +13,77 @@ extern "C" {
 
 #define AV_PIX_FMT_GREY8 AV_PIX_FMT_GRAY8
 
-std::optional<std::string> VideoPlayer::open_video(const char* video_filename, size_t window_width, size_t window_height)
+namespace
 {
+    // formats where data[0] is a full resolution, 8 bit luma plane
+    bool has_luma_plane(int format)
+    {
+        switch (format)
+        {
+            case AV_PIX_FMT_GREY8:
+            case AV_PIX_FMT_YUV420P:
+            case AV_PIX_FMT_YUV422P:
+            case AV_PIX_FMT_YUV444P:
+            case AV_PIX_FMT_YUV410P:
+            case AV_PIX_FMT_YUV411P:
+            case AV_PIX_FMT_YUV440P:
+            case AV_PIX_FMT_YUVJ420P:
+            case AV_PIX_FMT_YUVJ422P:
+            case AV_PIX_FMT_YUVJ444P:
+            case AV_PIX_FMT_YUVJ440P:
+            case AV_PIX_FMT_YUVA420P:
+            case AV_PIX_FMT_NV12:
+            case AV_PIX_FMT_NV21:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // swscale treats YUV without a range as limited, the J formats and grey are always full range
+    bool is_limited_range(const AVFrame* frame)
+    {
+        switch (frame->format)
+        {
+            case AV_PIX_FMT_GREY8:
+            case AV_PIX_FMT_YUVJ420P:
+            case AV_PIX_FMT_YUVJ422P:
+            case AV_PIX_FMT_YUVJ444P:
+            case AV_PIX_FMT_YUVJ440P:
+                return false;
+            default:
+                return frame->color_range != AVCOL_RANGE_JPEG;
+        }
+    }
+}
+
+std::optional<std::string> VideoPlayer::open_video(const char* video_filename, size_t window_width, size_t window_height, const DecoderOptions& decoder_options)
+{
+    if (auto err = probe(video_filename, decoder_options))
+    {
+        return err;
+    }
+
+    return open_decoder(window_width, window_height, decoder_options);
+}
+
+std::optional<std::string> VideoPlayer::probe(const char* video_filename, const DecoderOptions& decoder_options)
+{
+    auto probe_start = std::chrono::steady_clock::now();
+
+    _format_context = avformat_alloc_context();
+
+    if (!_format_context)
+    {
+        return "Could not create a format context";
+    }
+
+    if (auto err = _input.open(video_filename, decoder_options.input, _format_context))
+    {
+        return err;
+    }
+
+    // frees the context on failure
     int res = avformat_open_input(&_format_context, video_filename, nullptr, nullptr);
 
     if (res < 0)
@@ -29,6 +100,8 @@ std::optional<std::string> VideoPlayer::open_video(const char* video_filename, s
         return "failed to find stream information";
     }
 
+    _probe_time = std::chrono::steady_clock::now() - probe_start;
+
     _video_stream_index = av_find_best_stream(_format_context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
 
     if (_video_stream_index < 0)
@@ -36,6 +109,16 @@ std::optional<std::string> VideoPlayer::open_video(const char* video_filename, s
         return "no video stream found";
     }
 
+    const AVStream* video_stream = _format_context->streams[_video_stream_index];
+
+    // the average rate is what players use for constant framerate video, r_frame_rate is only a guess at the lowest common rate
+    _frame_rate = video_stream->avg_frame_rate.num && video_stream->avg_frame_rate.den ? video_stream->avg_frame_rate : video_stream->r_frame_rate;
+
+    return {};
+}
+
+std::optional<std::string> VideoPlayer::open_decoder(size_t window_width, size_t window_height, const DecoderOptions& decoder_options)
+{
     const AVStream* video_stream = _format_context->streams[_video_stream_index];
     const AVCodec* codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
 
@@ -44,8 +127,6 @@ std::optional<std::string> VideoPlayer::open_video(const char* video_filename, s
         return "A decoder for this video codec was not found";
     }
 
-    _fps = video_stream->r_frame_rate.num / video_stream->r_frame_rate.den;
-
     _codec_context = avcodec_alloc_context3(codec);
     
     if(!_codec_context || avcodec_parameters_to_context(_codec_context, video_stream->codecpar) < 0)
@@ -53,6 +134,22 @@ std::optional<std::string> VideoPlayer::open_video(const char* video_filename, s
         return "Could not create a video codec context";
     }
 
+    _codec_context->thread_count = decoder_options.thread_count;
+
+    switch (decoder_options.threading)
+    {
+        case DecoderThreading::Auto: _codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE; break;
+        case DecoderThreading::Frame: _codec_context->thread_type = FF_THREAD_FRAME; break;
+        case DecoderThreading::Slice: _codec_context->thread_type = FF_THREAD_SLICE; break;
+    }
+
+    if (decoder_options.low_delay)
+    {
+        _codec_context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+
+    _frame_pool.attach(_codec_context);
+
     if (avcodec_open2(_codec_context, codec, nullptr) < 0)
     {
         return "Failed to open codec";
@@ -63,61 +160,273 @@ std::optional<std::string> VideoPlayer::open_video(const char* video_filename, s
 
     _resize_width = window_width;
     _resize_height = window_height;
+    _direct_luma = decoder_options.direct_luma;
 
+    _sws_flags = SWS_BILINEAR;
     _sws_context = sws_getContext(_codec_context->width, _codec_context->height, _codec_context->pix_fmt,
                                     _resize_width, _resize_height, AV_PIX_FMT_GREY8,
-                                    SWS_BILINEAR, nullptr, nullptr, nullptr);
+                                    _sws_flags, nullptr, nullptr, nullptr);
     
     return {};
 }
 
-bool VideoPlayer::get_next_frame(uint8_t* buffer)
+std::string VideoPlayer::decoder_threading() const
 {
-    do
+    int thread_type = _codec_context->active_thread_type;
+    std::string description = std::to_string(_codec_context->thread_count) + (_codec_context->thread_count == 1 ? " thread" : " threads");
+
+    if (thread_type & FF_THREAD_FRAME) description += ", frame";
+    else if (thread_type & FF_THREAD_SLICE) description += ", slice";
+    else description += ", no threading";
+
+    return description;
+}
+
+bool VideoPlayer::receive_frame()
+{
+    // a packet can hold several frames and a threaded decoder holds frames back,
+    // so keep feeding packets until the decoder hands one out
+    while (true)
     {
-        if (av_read_frame(_format_context, _packet) < 0)
+        int response = TRACE_CALL(ReceiveFrame, avcodec_receive_frame(_codec_context, _frame));
+
+        if (response == 0)
+        {
+            return true;
+        }
+        else if (response == AVERROR_EOF)
         {
+            // everything was read in order, so every keyframe is in the index
+            if (_indexing) _index_complete = true;
+
+            return false;
+        }
+        else if (response != AVERROR(EAGAIN) || _draining)
+        {
+            std::cerr << "Error during decoding" << std::endl;
+
             return false;
         }
+
+        // EAGAIN: the decoder needs more input before it can output a frame
+        while (true)
+        {
+            if (TRACE_CALL(ReadPacket, av_read_frame(_format_context, _packet)) < 0)
+            {
+                // the container has ended, flush out the frames the decoder is still holding
+                _draining = true;
+
+                break;
+            }
+
+            if (_packet->stream_index == _video_stream_index) break;
+
+            av_packet_unref(_packet);
+        }
+
+        if (!_draining && _indexing && _packet->pts != AV_NOPTS_VALUE)
+        {
+            if ((_packet->flags & AV_PKT_FLAG_KEY) && (_keyframe_pts.empty() || _packet->pts > _keyframe_pts.back()))
+            {
+                _keyframe_pts.push_back(_packet->pts);
+            }
+
+            _indexed_until = std::max(_indexed_until, _packet->pts);
+        }
+
+        response = TRACE_CALL(SendPacket, avcodec_send_packet(_codec_context, _draining ? nullptr : _packet));
+
+        av_packet_unref(_packet);
+
+        if (response < 0 && response != AVERROR_EOF)
+        {
+            std::cerr << "Error sending a packet for decoding" << std::endl;
+
+            return false;
+        }
+    }
+}
+
+int64_t VideoPlayer::stream_start_time() const
+{
+    const AVStream* video_stream = _format_context->streams[_video_stream_index];
+
+    return video_stream->start_time == AV_NOPTS_VALUE ? 0 : video_stream->start_time;
+}
+
+std::chrono::nanoseconds VideoPlayer::duration() const
+{
+    const AVStream* video_stream = _format_context->streams[_video_stream_index];
+
+    if (video_stream->duration != AV_NOPTS_VALUE && video_stream->duration > 0)
+    {
+        return std::chrono::nanoseconds(av_rescale_q(video_stream->duration, video_stream->time_base, { 1, 1000000000 }));
     }
-    while(_packet->stream_index != _video_stream_index);
 
-    int response = avcodec_send_packet(_codec_context, _packet);
+    // some containers (eg. matroska) only know the length of the whole file
+    if (_format_context->duration != AV_NOPTS_VALUE && _format_context->duration > 0)
+    {
+        return std::chrono::nanoseconds(av_rescale_q(_format_context->duration, { 1, AV_TIME_BASE }, { 1, 1000000000 }));
+    }
+
+    return std::chrono::nanoseconds(0);
+}
 
-    if (response < 0)
+std::chrono::nanoseconds VideoPlayer::frame_duration() const
+{
+    return std::chrono::nanoseconds(_frame_rate.num ? av_rescale_q(1, av_inv_q(_frame_rate), { 1, 1000000000 }) : 0);
+}
+
+bool VideoPlayer::seek_stream(int64_t stream_pts)
+{
+    if (av_seek_frame(_format_context, _video_stream_index, stream_pts, AVSEEK_FLAG_BACKWARD) < 0)
     {
-        std::cerr << "Error sending a packet for decoding" << std::endl;
+        return false;
+    }
 
-        av_packet_unref(_packet);
+    // drops the frames still buffered from before the seek, and ends draining if the stream had ended
+    avcodec_flush_buffers(_codec_context);
+    _draining = false;
 
+    return true;
+}
+
+bool VideoPlayer::rewind()
+{
+    if (!seek_stream(stream_start_time()))
+    {
         return false;
     }
 
-    response = avcodec_receive_frame(_codec_context, _frame);
+    // carry on a frame after the last one, so the scheduler sees no jump
+    _loop_offset = _frame_time + frame_duration();
+    _seek_target.reset();
+    _indexing = true;
+    _frames_this_pass = 0;
+    _loop_count++;
 
-    if (response == AVERROR(EAGAIN) || response == AVERROR_EOF)
+    return true;
+}
+
+std::optional<std::string> VideoPlayer::seek(std::chrono::nanoseconds timestamp)
+{
+    const AVStream* video_stream = _format_context->streams[_video_stream_index];
+    int64_t target = av_rescale_q(timestamp.count(), { 1, 1000000000 }, video_stream->time_base) + stream_start_time();
+    int64_t seek_pts = target;
+
+    // the index knows exactly which keyframe comes before the target, the demuxer's own index may be coarser or missing
+    bool indexed = _index_complete || target <= _indexed_until;
+
+    if (indexed)
     {
-        av_packet_unref(_packet);
+        auto keyframe = std::upper_bound(_keyframe_pts.begin(), _keyframe_pts.end(), target);
 
-        return false;
+        if (keyframe != _keyframe_pts.begin()) seek_pts = *(keyframe - 1);
     }
-    else if (response < 0)
+
+    if (!seek_stream(seek_pts))
     {
-        std::cerr << "Error during decoding" << std::endl;
+        return "could not seek, the input may not be seekable";
+    }
 
-        av_packet_unref(_packet);
+    // reading on from an indexed keyframe continues the index without leaving a gap
+    _indexing = indexed;
+    _seek_target = timestamp;
+    _loop_offset = std::chrono::nanoseconds(0);
+    _frames_this_pass = 0;
 
-        return false;
+    return {};
+}
+
+bool VideoPlayer::get_next_frame(uint8_t* buffer)
+{
+    const AVStream* video_stream = _format_context->streams[_video_stream_index];
+
+    while (true)
+    {
+        if (!receive_frame())
+        {
+            // a pass which decoded nothing would loop forever
+            if (!_looping || _frames_this_pass == 0 || !rewind())
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        _frames_this_pass++;
+
+        if (_frame->best_effort_timestamp != AV_NOPTS_VALUE)
+        {
+            _frame_time = _loop_offset + std::chrono::nanoseconds(av_rescale_q(_frame->best_effort_timestamp - stream_start_time(), video_stream->time_base, { 1, 1000000000 }));
+        }
+        else
+        {
+            // no timestamp, assume it follows straight on from the previous frame
+            _frame_time += frame_duration();
+        }
+
+        // decoding forward from the keyframe to the seek target, these frames are never shown so skip scaling them
+        if (_seek_target && _frame_time < *_seek_target)
+        {
+            continue;
+        }
+
+        _seek_target.reset();
+
+        break;
+    }
+
+    scale_frame(buffer);
+
+    return true;
+}
+
+bool VideoPlayer::uses_swscale() const
+{
+    // the same test scale_frame() makes for every frame
+    return !_direct_luma || !has_luma_plane(_codec_context->pix_fmt) || _codec_context->width < (int)_resize_width || _codec_context->height < (int)_resize_height;
+}
+
+void VideoPlayer::scale_frame(uint8_t* buffer)
+{
+    TRACE_SCOPE(Scale);
+
+    // box filtering only shrinks, upscaling to a grid bigger than the video is left to swscale
+    size_t width = (size_t)_frame->width;
+    size_t height = (size_t)_frame->height;
+
+    if (_direct_luma && has_luma_plane(_frame->format) && _frame->linesize[0] > 0 && width >= _resize_width && height >= _resize_height)
+    {
+        bool limited_range = is_limited_range(_frame);
+
+        if (!_luma_downsampler || !_luma_downsampler->matches(width, height, limited_range))
+        {
+            _luma_downsampler.emplace(width, height, _resize_width, _resize_height, limited_range);
+        }
+
+        _luma_downsampler->downsample(_frame->data[0], (size_t)_frame->linesize[0], buffer);
+
+        return;
+    }
+
+    int sws_flags = _fast_scaling.load(std::memory_order_relaxed) ? SWS_FAST_BILINEAR : SWS_BILINEAR;
+
+    if (sws_flags != _sws_flags)
+    {
+        sws_freeContext(_sws_context);
+
+        _sws_flags = sws_flags;
+        _sws_context = sws_getContext(_codec_context->width, _codec_context->height, _codec_context->pix_fmt,
+                                        _resize_width, _resize_height, AV_PIX_FMT_GREY8,
+                                        _sws_flags, nullptr, nullptr, nullptr);
     }
 
     uint8_t* sws_data[AV_NUM_DATA_POINTERS] = { buffer };
     int sws_linesize[AV_NUM_DATA_POINTERS] = { (int)_resize_width };
 
     sws_scale(_sws_context, _frame->data, _frame->linesize, 0, _codec_context->height, sws_data, sws_linesize);
-
-    av_packet_unref(_packet);
-
-    return true;
 }
 
 VideoPlayer::~VideoPlayer()
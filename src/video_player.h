@@ -1,25 +1,111 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include <optional>
+#include <vector>
+#include <chrono>
 #include <cstdint>
 
+#include "luma_downsample.h"
+#include "frame_pool.h"
+#include "video_input.h"
+
 extern "C" {
     #include <libavcodec/avcodec.h>
     #include <libavformat/avformat.h>
 }
 
+enum class DecoderThreading
+{
+    Auto,  // whatever the codec supports, frame threading first
+    Frame, // decodes several frames at once, adds a frame of delay per thread
+    Slice  // splits each frame between threads, no extra delay but only if the stream has slices
+};
+
+struct DecoderOptions
+{
+    // 0 picks one thread per core
+    int thread_count = 0;
+    DecoderThreading threading = DecoderThreading::Auto;
+
+    // asks the decoder not to buffer frames, this rules out frame threading
+    bool low_delay = false;
+
+    // shrink the Y plane of YUV video straight to the grid instead of converting the whole frame with swscale
+    bool direct_luma = true;
+
+    // how the container is read, see VideoInput
+    InputOptions input;
+};
+
 class VideoPlayer
 {
 private:
+    // reads the container for the format context, and outlives it by being a member
+    VideoInput _input;
+
     AVFormatContext* _format_context;
     AVCodecContext* _codec_context;
     AVFrame* _frame;
     AVPacket* _packet;
     struct SwsContext* _sws_context;
+
+    // the flags _sws_context was made with, and the ones asked for from another thread by set_fast_scaling()
+    int _sws_flags;
+    std::atomic<bool> _fast_scaling;
     int _video_stream_index;
+
+    // where the decoder's frames come from, freed after the codec context by being a member
+    DecoderFramePool _frame_pool;
+
+    // built for the first frame with a luma plane, and again if the frame size or range changes
+    bool _direct_luma;
+    std::optional<LumaDownsampler> _luma_downsampler;
+
+    // the container has ended and the decoder is handing out its buffered frames
+    bool _draining;
     size_t _resize_width, _resize_height;
-    size_t _fps;
+    AVRational _frame_rate;
+    std::chrono::nanoseconds _frame_time;
+
+    // timestamps of the keyframes read so far in stream time base, built up while playing
+    // only packets read in order from the start are indexed, so the index never has gaps
+    std::vector<int64_t> _keyframe_pts;
+    int64_t _indexed_until;
+    bool _indexing;
+    bool _index_complete;
+
+    // frames before this time are decoded but not scaled, so seeks land on the exact frame
+    std::optional<std::chrono::nanoseconds> _seek_target;
+
+    bool _looping;
+    size_t _loop_count;
+
+    // frames decoded since the last rewind, shown or not
+    size_t _frames_this_pass;
+
+    // added to frame times, so timestamps keep counting up across loops
+    std::chrono::nanoseconds _loop_offset;
+
+    // time probe() spent opening the container and probing its streams
+    std::chrono::nanoseconds _probe_time;
+
+    // decodes the next frame into _frame
+    // returns false at the end of the video or on an error
+    bool receive_frame();
+
+    // seeks the demuxer to the keyframe at or before the timestamp and resets the decoder
+    bool seek_stream(int64_t stream_pts);
+
+    // starts the next pass of a loop without reopening anything
+    bool rewind();
+
+    // scales _frame into buffer, straight from the luma plane where possible
+    void scale_frame(uint8_t* buffer);
+
+    int64_t stream_start_time() const;
+    std::chrono::nanoseconds frame_duration() const;
 
 public:
     VideoPlayer()
@@ -29,23 +115,115 @@ public:
     _frame(nullptr),
     _packet(nullptr),
     _sws_context(nullptr),
+    _sws_flags(0),
+    _fast_scaling(false),
     _video_stream_index(0),
+    _direct_luma(true),
+    _draining(false),
     _resize_width(0),
     _resize_height(0),
-    _fps(0)
+    _frame_rate({ 0, 1 }),
+    _frame_time(0),
+    _indexed_until(0),
+    _indexing(true),
+    _index_complete(false),
+    _looping(false),
+    _loop_count(0),
+    _frames_this_pass(0),
+    _loop_offset(0),
+    _probe_time(0)
     {
     }
     
-    std::optional<std::string> open_video(const char* video_filename, size_t window_width, size_t window_height);
+    // probe() then open_decoder()
+    std::optional<std::string> open_video(const char* video_filename, size_t window_width, size_t window_height, const DecoderOptions& decoder_options = {});
+
+    // opens the container and finds the video stream, the slow part of opening on a cold cache or a live stream
+    // doesn't need the grid size, so it can run on another thread while the display is being set up
+    std::optional<std::string> probe(const char* video_filename, const DecoderOptions& decoder_options = {});
 
-    size_t framerate() const
+    // sets up the decoder and scaler for a grid of window_width x window_height cells, after a successful probe()
+    std::optional<std::string> open_decoder(size_t window_width, size_t window_height, const DecoderOptions& decoder_options = {});
+
+    // describes the threading the decoder actually ended up using, eg. "4 threads, frame"
+    std::string decoder_threading() const;
+
+    // describes where the container is read from, eg. "memory mapped file, 12.3MB"
+    std::string input_description() const
     {
-        return _fps;
+        return _input.description();
+    }
+
+    // time spent opening the container and probing its streams before the decoder could be set up
+    std::chrono::nanoseconds probe_time() const
+    {
+        return _probe_time;
+    }
+
+    // frame planes the decoder has allocated, stops growing once playback settles
+    size_t frame_buffer_allocations() const
+    {
+        return _frame_pool.allocations();
+    }
+
+    // exact rate, eg. 30000/1001 for 29.97fps
+    AVRational frame_rate() const
+    {
+        return _frame_rate;
+    }
+
+    double framerate() const
+    {
+        return _frame_rate.den ? av_q2d(_frame_rate) : 0.0;
+    }
+
+    // length of the video stream from the container, 0 when it doesn't say (eg. a live stream)
+    std::chrono::nanoseconds duration() const;
+
+    // frames go through swscale rather than the direct luma path, so set_fast_scaling() has something to speed up
+    // known once the decoder is open, from the stream's pixel format and size against the grid
+    bool uses_swscale() const;
+
+    // switches swscale to its cheaper filtering from the next frame, safe to call while another thread decodes
+    // frames on the direct luma path are unaffected, they are already cheap
+    void set_fast_scaling(bool fast_scaling)
+    {
+        _fast_scaling.store(fast_scaling, std::memory_order_relaxed);
     }
 
     // copies frame data into buffer
     // returns true on success
     bool get_next_frame(uint8_t* buffer);
 
+    // the next get_next_frame() gives the first frame at or after the timestamp, relative to the start of the stream
+    // starts decoding from the closest keyframe before it, using the keyframe index where it reaches
+    std::optional<std::string> seek(std::chrono::nanoseconds timestamp);
+
+    // start again from the beginning once the video ends instead of finishing, without reopening
+    // the container or reallocating the decoder, so looped playback has no gap
+    void set_looping(bool looping)
+    {
+        _looping = looping;
+    }
+
+    // times the video has wrapped around
+    size_t loop_count() const
+    {
+        return _loop_count;
+    }
+
+    // keyframes indexed so far, every one in the video once the first pass has finished
+    size_t indexed_keyframes() const
+    {
+        return _keyframe_pts.size();
+    }
+
+    // presentation time of the last frame from get_next_frame(), relative to the start of the stream
+    // keeps increasing across loops
+    std::chrono::nanoseconds frame_time() const
+    {
+        return _frame_time;
+    }
+
     ~VideoPlayer();
 };
@@ -0,0 +1,66 @@
+#include "video_source.h"
+#include "trace.h"
+
+VideoFrameSource::VideoFrameSource(size_t levels, DitherMode dither)
+:
+_quantizer(levels, dither),
+_frame(nullptr),
+_started(false)
+{
+}
+
+std::optional<std::string> VideoFrameSource::probe(const char* video_filename, const DecoderOptions& decoder_options)
+{
+    return _video_player.probe(video_filename, decoder_options);
+}
+
+std::optional<std::string> VideoFrameSource::open(size_t width, size_t height, const DecoderOptions& decoder_options, size_t ring_depth)
+{
+    if (auto err = _video_player.open_decoder(width, height, decoder_options))
+    {
+        return err;
+    }
+
+    _index_buffer.emplace(width * height);
+    _indices.emplace(_index_buffer->data(), width, height);
+    _decoder.emplace(_video_player, width, height, ring_depth);
+
+    return {};
+}
+
+bool VideoFrameSource::next_frame(std::chrono::nanoseconds& pts)
+{
+    if (!_started)
+    {
+        _decoder->start();
+        _started = true;
+    }
+
+    // the previous frame was dropped without being quantized
+    if (_frame)
+    {
+        _decoder->release_frame();
+    }
+
+    _frame = TRACE_CALL(WaitForDecoder, _decoder->next_frame());
+
+    if (!_frame)
+    {
+        return false;
+    }
+
+    pts = _frame->pts;
+
+    return true;
+}
+
+const ImageBuffer<uint8_t>& VideoFrameSource::frame_indices()
+{
+    TRACE_CALL(Quantize, _quantizer.quantize(_frame->image, *_indices));
+
+    // hand the slot back straight away so the decoder can refill it while the frame is composed
+    _decoder->release_frame();
+    _frame = nullptr;
+
+    return *_indices;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <cstdint>
+
+#include "frame_source.h"
+#include "video_player.h"
+#include "decode_thread.h"
+#include "quantize.h"
+#include "aligned_buffer.h"
+
+// Decodes a video on its own thread and quantizes each shown frame into cursor indices
+class VideoFrameSource : public FrameSource
+{
+private:
+    VideoPlayer _video_player;
+
+    // declared after the player so the thread is stopped before the player is closed
+    std::optional<DecodeThread> _decoder;
+    ShadeQuantizer _quantizer;
+
+    // sized by open(), once the grid is known
+    std::optional<AlignedBuffer<uint8_t>> _index_buffer;
+    std::optional<ImageBuffer<uint8_t>> _indices;
+
+    // frame taken from the decoder which hasn't been handed back yet
+    const DecodedFrame* _frame;
+
+    // the decode thread is started by the first next_frame(), so seeking and looping
+    // can still be set up on the player without racing it
+    bool _started;
+
+public:
+    // levels: number of cursor shades
+    VideoFrameSource(size_t levels, DitherMode dither);
+    VideoFrameSource(const VideoFrameSource&) = delete;
+
+    // opens the container, which doesn't need the grid size so it can overlap setting up the display
+    std::optional<std::string> probe(const char* video_filename, const DecoderOptions& decoder_options);
+
+    // sets up decoding into a width x height cell grid after probe(), decoded ring_depth frames ahead once playback starts
+    std::optional<std::string> open(size_t width, size_t height, const DecoderOptions& decoder_options, size_t ring_depth);
+
+    double framerate() const override
+    {
+        return _video_player.framerate();
+    }
+
+    std::optional<std::string> seek(std::chrono::nanoseconds timestamp) override
+    {
+        return _video_player.seek(timestamp);
+    }
+
+    void set_looping(bool looping) override
+    {
+        _video_player.set_looping(looping);
+    }
+
+    bool next_frame(std::chrono::nanoseconds& pts) override;
+    const ImageBuffer<uint8_t>& frame_indices() override;
+
+    // trades quality for speed mid-playback, see QualityGovernor
+    void set_dither(DitherMode dither)
+    {
+        _quantizer.set_dither(dither);
+    }
+
+    void set_fast_scaling(bool fast_scaling)
+    {
+        _video_player.set_fast_scaling(fast_scaling);
+    }
+
+    const VideoPlayer& video_player() const
+    {
+        return _video_player;
+    }
+
+    const DecodeThread& decoder() const
+    {
+        return *_decoder;
+    }
+};
@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(size_t thread_count)
+:
+_generation(0),
+_remaining(0),
+_stop(false),
+_invoke(nullptr),
+_context(nullptr),
+_last_times(std::max(thread_count, (size_t)1)),
+_total_times(std::max(thread_count, (size_t)1)),
+_runs(0)
+{
+    for (size_t i = 1; i < size(); i++)
+    {
+        _threads.emplace_back(&WorkerPool::worker, this, i);
+    }
+}
+
+void WorkerPool::worker(size_t index)
+{
+    size_t seen_generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _start_condition.wait(lock, [&]() { return _stop || _generation != seen_generation; });
+
+            if (_stop) return;
+
+            seen_generation = _generation;
+        }
+
+        execute(index);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (--_remaining == 0)
+            {
+                _done_condition.notify_one();
+            }
+        }
+    }
+}
+
+void WorkerPool::execute(size_t index)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    _invoke(_context, index);
+
+    _last_times[index] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    _total_times[index] += _last_times[index];
+}
+
+void WorkerPool::run_erased(void (*invoke)(void* context, size_t index), void* context)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _invoke = invoke;
+        _context = context;
+        _remaining = _threads.size();
+        _generation++;
+    }
+
+    _start_condition.notify_all();
+
+    execute(0);
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _done_condition.wait(lock, [&]() { return _remaining == 0; });
+    }
+
+    _runs++;
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stop = true;
+    }
+
+    _start_condition.notify_all();
+
+    for (std::thread& thread : _threads)
+    {
+        thread.join();
+    }
+}
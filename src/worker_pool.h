@@ -0,0 +1,64 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+
+// Fixed set of threads which all run the same task once per run() call,
+// each with its own index. The calling thread takes index 0, so a pool of
+// size 1 runs everything inline without any threads.
+class WorkerPool
+{
+private:
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _start_condition;
+    std::condition_variable _done_condition;
+    size_t _generation;
+    size_t _remaining;
+    bool _stop;
+
+    // type erased task, kept as a plain pointer pair so run() never allocates
+    void (*_invoke)(void* context, size_t index);
+    void* _context;
+
+    std::vector<std::chrono::nanoseconds> _last_times;
+    std::vector<std::chrono::nanoseconds> _total_times;
+    size_t _runs;
+
+    void worker(size_t index);
+    void execute(size_t index);
+    void run_erased(void (*invoke)(void* context, size_t index), void* context);
+
+public:
+    WorkerPool(size_t thread_count);
+    WorkerPool(const WorkerPool&) = delete;
+
+    size_t size() const
+    {
+        return _last_times.size();
+    }
+
+    // calls task(index) for every index in [0, size()) in parallel and waits for all of them
+    template <typename F>
+    void run(F&& task)
+    {
+        run_erased([](void* context, size_t index) { (*static_cast<F*>(context))(index); }, &task);
+    }
+
+    // time each thread spent in the last run
+    std::chrono::nanoseconds last_time(size_t index) const
+    {
+        return _last_times[index];
+    }
+
+    std::chrono::nanoseconds average_time(size_t index) const
+    {
+        return _runs ? _total_times[index] / (long)_runs : std::chrono::nanoseconds(0);
+    }
+
+    ~WorkerPool();
+};
@@ -0,0 +1,487 @@
+#include <X11/Xcursor/Xcursor.h>
+#include <X11/cursorfont.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <functional>
+#include <fstream>
+#include <set>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include "x11/cursor_pixel.h"
+
+namespace
+{
+    uint32_t CursorType_to_x11_cursor(CursorType type)
+    {
+        switch (type)
+        {
+            case CursorType::Pointer: return XC_left_ptr;
+            case CursorType::Hand: return XC_hand2;
+            case CursorType::IBeam: return XC_xterm;
+            case CursorType::DownArrow: return XC_sb_down_arrow;
+        }
+
+        return XC_num_glyphs;
+    }
+
+    // the file name Xcursor looks for in a theme's cursors directory
+    const char* CursorType_to_x11_name(CursorType type)
+    {
+        switch (type)
+        {
+            case CursorType::Pointer: return "left_ptr";
+            case CursorType::Hand: return "hand2";
+            case CursorType::IBeam: return "xterm";
+            case CursorType::DownArrow: return "sb_down_arrow";
+        }
+
+        return "";
+    }
+
+    // the theme and nominal size the shades are loaded with, null and 0 leave them to Xcursor
+    const char* const cursor_theme = nullptr;
+    const int cursor_size = 0;
+
+    const char atlas_cache_magic[8] = { 'C', 'U', 'R', 'S', 'A', 'T', 'L', 'S' };
+    const uint32_t atlas_cache_version = 2;
+
+    // followed by an AtlasCacheEntry per shade, then every shade's pixels back to back
+    struct AtlasCacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t shade_count;
+
+        // the theme files the shades were loaded from, see theme_hash()
+        uint64_t theme_hash;
+    };
+
+    struct AtlasCacheEntry
+    {
+        uint32_t cursor_type;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    void hash_combine(uint64_t& hash, uint64_t value)
+    {
+        hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    }
+
+    // folds in the path, modification time and size of the file, if it exists
+    bool hash_file(uint64_t& hash, const std::string& path)
+    {
+        struct stat file_stat;
+
+        // stat() follows the symlinks themes are full of, so a changed target counts too
+        if (stat(path.c_str(), &file_stat) != 0)
+        {
+            return false;
+        }
+
+        hash_combine(hash, std::hash<std::string>()(path));
+        hash_combine(hash, (uint64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec);
+        hash_combine(hash, (uint64_t)file_stat.st_size);
+
+        return true;
+    }
+
+    // the themes an index.theme's "Inherits=" line names, eg. "Inherits=Adwaita" in the default theme
+    void inherited_themes(const std::string& index_path, std::vector<std::string>& themes)
+    {
+        std::ifstream index(index_path);
+        std::string line;
+
+        while (std::getline(index, line))
+        {
+            if (line.compare(0, 8, "Inherits") != 0) continue;
+
+            size_t equals = line.find('=');
+
+            if (equals == std::string::npos) continue;
+
+            // separated by commas, semicolons or spaces, like Xcursor accepts
+            std::string theme;
+
+            for (size_t i = equals + 1; i <= line.size(); i++)
+            {
+                if (i == line.size() || line[i] == ',' || line[i] == ';' || line[i] == ' ' || line[i] == '\t')
+                {
+                    if (!theme.empty()) themes.push_back(theme);
+
+                    theme.clear();
+                }
+                else
+                {
+                    theme += line[i];
+                }
+            }
+        }
+    }
+
+    // Identifies the cursor files Xcursor would load the shades from: every theme it could look in
+    // (the starting one and all it inherits), with the modification time and size of each theme's
+    // index.theme and shade files in every library directory. Switching themes through the default
+    // theme's Inherits line, or updating a theme package, changes it.
+    uint64_t theme_hash(const char* theme, std::initializer_list<CursorType> cursor_shades)
+    {
+        const char* library_path = XcursorLibraryPath();
+        const char* home = std::getenv("HOME");
+        std::vector<std::string> directories;
+        std::string directory;
+
+        for (const char* c = library_path ? library_path : ""; ; c++)
+        {
+            if (*c == ':' || *c == '\0')
+            {
+                // Xcursor expands a leading ~ to the home directory
+                if (!directory.empty() && directory[0] == '~' && home) directory = home + directory.substr(1);
+                if (!directory.empty()) directories.push_back(directory);
+
+                directory.clear();
+
+                if (*c == '\0') break;
+            }
+            else
+            {
+                directory += *c;
+            }
+        }
+
+        uint64_t hash = std::hash<std::string>()(library_path ? library_path : "");
+        hash_combine(hash, (uint64_t)cursor_size);
+
+        // Xcursor falls back on the default theme when the one asked for doesn't have a cursor
+        std::vector<std::string> themes = { theme ? theme : "default", "default" };
+        std::set<std::string> visited;
+
+        for (size_t i = 0; i < themes.size(); i++)
+        {
+            // inheritance can loop, and each theme only needs looking at once
+            if (!visited.insert(themes[i]).second) continue;
+
+            for (const std::string& library : directories)
+            {
+                std::string theme_directory = library + "/" + themes[i];
+                std::string index_path = theme_directory + "/index.theme";
+
+                if (hash_file(hash, index_path))
+                {
+                    inherited_themes(index_path, themes);
+                }
+
+                for (CursorType type : cursor_shades)
+                {
+                    hash_file(hash, theme_directory + "/cursors/" + CursorType_to_x11_name(type));
+                }
+            }
+        }
+
+        return hash;
+    }
+}
+
+
+bool CursorPixel::load_mouse_image(CursorType cursor_type, std::vector<uint32_t>& atlas, size_t& width, size_t& height)
+{
+    XcursorImage* cursor_image = XcursorShapeLoadImage(CursorType_to_x11_cursor(cursor_type), cursor_theme, cursor_size);
+
+    if (!cursor_image)
+    {
+        return false;
+    }
+
+    // the cursor image will have some transparent padding around it, so it'll need to be cropped
+    size_t start_x = cursor_image->width - 1;
+    size_t start_y = cursor_image->width - 1;
+    size_t end_x = 0;
+    size_t end_y = 0;
+
+    /*
+    Clip off the rows and columns where the alpha channel is 0 
+    0 00000 000
+    ___________
+    0 11111 000
+    0 11110 000
+    0 00110 000
+    0 00011 000
+    ___________
+    0 00000 000
+    */
+
+    for (size_t y = 0; y < cursor_image->height; y++)
+    {
+        bool row_not_empty = false;
+        size_t x = 0;
+
+        for (; x < cursor_image->width; x++)
+        {
+            uint8_t alpha = cursor_image->pixels[y * cursor_image->width + x] >> 24;
+
+            if(alpha != 0)
+            {
+                row_not_empty = true;
+
+                break;
+            }
+        }
+
+        if (row_not_empty)
+        {
+            if(y < start_y) start_y = y;                
+            if(x < start_x) start_x = x;
+        }
+    }
+
+    for (size_t y = cursor_image->height; y-- != 0;)
+    {
+        bool row_not_empty = false;
+        size_t x = cursor_image->width;
+
+        while (x-- != 0)
+        {
+            uint8_t alpha = cursor_image->pixels[y * cursor_image->width + x] >> 24;
+
+            if(alpha != 0)
+            {
+                row_not_empty = true;
+
+                break;
+            }
+        }
+
+        if (row_not_empty)
+        {
+            if(y > end_y) end_y = y;        
+            if(x > end_x) end_x = x;
+        }
+    }
+
+    size_t cursor_width = (end_x - start_x) + 1;
+    size_t cursor_height = (end_y - start_y) + 1;
+
+    for(size_t y = 0; y < cursor_height; y++)
+    {
+        for(size_t x = 0; x < cursor_width; x++)
+        {
+            atlas.push_back(cursor_image->pixels[(start_y + y) * cursor_image->width + (start_x + x)]);
+        }
+    }
+
+    width = cursor_width;
+    height = cursor_height;
+
+    XcursorImageDestroy(cursor_image);
+
+    return true;
+}
+
+CursorPixel::CursorPixel(CursorPixel::cursor_list cursor_shades, bool use_cache)
+:
+_max_width(0),
+_max_height(0),
+_mapping(nullptr),
+_mapping_size(0)
+{
+    if(cursor_shades.size() == 0)
+    {
+        std::cerr << "error: no cursor list provided to CursorPixel()" << std::endl;
+
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::string path = use_cache ? cache_path() : std::string();
+
+    if (!path.empty() && load_cache(path, cursor_shades))
+    {
+        return;
+    }
+
+    std::vector<size_t> sizes;
+
+    for (CursorType type : cursor_shades)
+    {
+        size_t width = 0, height = 0;
+
+        if(!load_mouse_image(type, _atlas, width, height))
+        {
+            std::cerr << "error: could not get mouse cursor image" << std::endl;
+
+            std::exit(EXIT_FAILURE);
+        }
+
+        sizes.push_back(width);
+        sizes.push_back(height);
+    }
+
+    create_views(_atlas.data(), sizes);
+
+    if (!path.empty())
+    {
+        save_cache(path, cursor_shades, sizes);
+    }
+}
+
+CursorPixel::CursorPixel(std::vector<uint32_t> atlas, const std::vector<size_t>& sizes)
+:
+_atlas(std::move(atlas)),
+_max_width(0),
+_max_height(0),
+_mapping(nullptr),
+_mapping_size(0)
+{
+    create_views(_atlas.data(), sizes);
+}
+
+std::string CursorPixel::cache_path()
+{
+    const char* cache_home = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    std::string directory;
+
+    if (cache_home && *cache_home) directory = cache_home;
+    else if (home && *home) directory = std::string(home) + "/.cache";
+    else return {};
+
+    // which theme files it came from is checked against its header, so one file serves every theme
+    return directory + "/cursor-video/atlas.bin";
+}
+
+bool CursorPixel::load_cache(const std::string& path, cursor_list cursor_shades)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(AtlasCacheHeader))
+    {
+        close(fd);
+
+        return false;
+    }
+
+    // private and writable so the shades can be handed out like loaded ones, nothing writes to them so no page is ever copied
+    size_t size = file_stat.st_size;
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    AtlasCacheHeader header;
+
+    std::memcpy(&header, bytes, sizeof(header));
+
+    size_t pixels_offset = sizeof(header) + cursor_shades.size() * sizeof(AtlasCacheEntry);
+    bool valid = std::memcmp(header.magic, atlas_cache_magic, sizeof(atlas_cache_magic)) == 0 && header.version == atlas_cache_version &&
+                 header.shade_count == cursor_shades.size() && header.theme_hash == theme_hash(cursor_theme, cursor_shades) && size >= pixels_offset;
+
+    std::vector<size_t> sizes;
+    size_t pixel_count = 0;
+
+    for (size_t i = 0; valid && i < cursor_shades.size(); i++)
+    {
+        AtlasCacheEntry entry;
+
+        std::memcpy(&entry, bytes + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        valid = entry.cursor_type == (uint32_t)cursor_shades.begin()[i] && entry.width && entry.height;
+
+        sizes.push_back(entry.width);
+        sizes.push_back(entry.height);
+        pixel_count += (size_t)entry.width * entry.height;
+    }
+
+    if (!valid || size != pixels_offset + pixel_count * sizeof(uint32_t))
+    {
+        munmap(data, size);
+
+        return false;
+    }
+
+    _mapping = data;
+    _mapping_size = size;
+
+    create_views((uint32_t*)(bytes + pixels_offset), sizes);
+
+    return true;
+}
+
+void CursorPixel::save_cache(const std::string& path, cursor_list cursor_shades, const std::vector<size_t>& sizes) const
+{
+    // eg. ~/.cache and ~/.cache/cursor-video, both of which may not exist yet
+    std::string directory = path.substr(0, path.rfind('/'));
+
+    mkdir(directory.substr(0, directory.rfind('/')).c_str(), 0755);
+    mkdir(directory.c_str(), 0755);
+
+    // written next to the cache and renamed over it, so a launch running at the same time never maps half a file
+    std::string temporary_path = path + "." + std::to_string(getpid()) + ".tmp";
+    FILE* file = std::fopen(temporary_path.c_str(), "wb");
+
+    if (!file)
+    {
+        return;
+    }
+
+    AtlasCacheHeader header = {};
+
+    std::memcpy(header.magic, atlas_cache_magic, sizeof(atlas_cache_magic));
+    header.version = atlas_cache_version;
+    header.shade_count = (uint32_t)cursor_shades.size();
+    header.theme_hash = theme_hash(cursor_theme, cursor_shades);
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (size_t i = 0; written && i < cursor_shades.size(); i++)
+    {
+        AtlasCacheEntry entry = { (uint32_t)cursor_shades.begin()[i], (uint32_t)sizes[i * 2], (uint32_t)sizes[i * 2 + 1] };
+
+        written = std::fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+
+    written = written && std::fwrite(_atlas.data(), sizeof(uint32_t), _atlas.size(), file) == _atlas.size();
+    written = std::fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary_path.c_str());
+    }
+}
+
+void CursorPixel::create_views(uint32_t* pixels, const std::vector<size_t>& sizes)
+{
+    // only done once the atlas is complete, as growing it would move the pixels
+
+    for (size_t i = 0; i + 1 < sizes.size(); i += 2)
+    {
+        size_t width = sizes[i];
+        size_t height = sizes[i + 1];
+
+        if(width > _max_width) _max_width = width;
+        if(height > _max_height) _max_height = height;
+
+        _image_shades.emplace_back(pixels, width, height);
+        pixels += width * height;
+    }
+}
+
+CursorPixel::~CursorPixel()
+{
+    if (_mapping) munmap(_mapping, _mapping_size);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <initializer_list>
+#include <cstdint>
+
+#include "misc.h"
+
+// The cropped cursor images used as shades, darkest first.
+// Only loads the images from the cursor theme, so it works without a display.
+//
+// Loading and cropping every shade from the theme takes a while, so the cropped atlas
+// is cached in a file which later launches map straight in. The cache records which theme
+// files the shades were loaded from, and is loaded again from the theme when any of them change.
+class CursorPixel
+{
+public:
+    using cursor_list = std::initializer_list<CursorType>;
+
+private:
+    // every shade's pixels back to back, _image_shades point into it or into the mapped cache file
+    std::vector<uint32_t> _atlas;
+    std::vector<ImageBuffer<uint32_t>> _image_shades;
+    size_t _max_width, _max_height;
+
+    // the cache file, when the shades were loaded from it
+    void* _mapping;
+    size_t _mapping_size;
+
+    // appends the cropped cursor image to the atlas
+    static bool load_mouse_image(CursorType cursor_type, std::vector<uint32_t>& atlas, size_t& width, size_t& height);
+
+    // the cache file, empty if there's nowhere to keep it
+    static std::string cache_path();
+
+    // maps the cache file if it holds exactly these shades, loaded from the theme files as they are now
+    bool load_cache(const std::string& path, cursor_list cursor_shades);
+
+    // writes the atlas to the cache file, failing quietly since the cache is only an optimisation
+    void save_cache(const std::string& path, cursor_list cursor_shades, const std::vector<size_t>& sizes) const;
+
+    // pixels: every shade back to back, sizes: width and height of each of them
+    void create_views(uint32_t* pixels, const std::vector<size_t>& sizes);
+
+public:
+    // use_cache: load the shades from the atlas cache if it has them, and write it if it doesn't
+    CursorPixel(cursor_list cursor_shades, bool use_cache = true);
+
+    // uses already loaded shades, eg. synthetic ones for benchmarks
+    // atlas: every shade's pixels back to back, sizes: width and height of each shade
+    CursorPixel(std::vector<uint32_t> atlas, const std::vector<size_t>& sizes);
+    CursorPixel(const CursorPixel&) = delete;
+
+    // Translates value out of 255 into an index into the cursors array.
+    // White shades (around 255ish) return count(), meaning no cursor
+    size_t get_cursor_index(uint8_t shade) const
+    {
+        return shade_to_index(shade, _image_shades.size());
+    }
+
+    static size_t shade_to_index(uint8_t shade, size_t count)
+    {
+        return (size_t)shade * (count + 1) / 256;
+    }
+
+    // returns null for the blank index
+    const ImageBuffer<uint32_t>* get_image(size_t index) const
+    {
+        return index >= _image_shades.size() ? nullptr : &_image_shades[index];
+    }
+
+    const ImageBuffer<uint32_t>* get_cursor_image(uint8_t shade) const
+    {
+        return get_image(get_cursor_index(shade));
+    }
+
+    // number of cursor shades, also the index used for blank cells
+    size_t count() const { return _image_shades.size(); }
+
+    size_t max_width() const { return _max_width; }
+    size_t max_height() const { return _max_height; }
+
+    // the shades came out of the atlas cache rather than the cursor theme
+    bool from_cache() const { return _mapping != nullptr; }
+
+    ~CursorPixel();
+};
@@ -2,176 +2,109 @@
 #include <X11/Xutil.h>
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/shape.h>
-#include <X11/Xcursor/Xcursor.h>
-#include <X11/cursorfont.h>
 #include <X11/Xatom.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
 
 #include "x11/cursor_window.h"
+#include "trace.h"
 
 namespace
 {
-    uint32_t CursorType_to_x11_cursor(CursorType type)
+    bool shm_attach_failed = false;
+
+    int shm_error_handler(Display*, XErrorEvent*)
     {
-        switch (type)
-        {
-            case CursorType::Pointer: return XC_left_ptr;
-            case CursorType::Hand: return XC_hand2;
-            case CursorType::IBeam: return XC_xterm;
-            case CursorType::DownArrow: return XC_sb_down_arrow;
-        }
+        shm_attach_failed = true;
 
-        return XC_num_glyphs;
+        return 0;
+    }
+
+    Bool is_event_type(Display*, XEvent* event, XPointer type)
+    {
+        return event->type == *(int*)type;
     }
 }
 
 
-XImage* CursorPixel::get_mouse_image(CursorType cursor_type)
-{
-    XcursorImage* cursor_image = XcursorShapeLoadImage(CursorType_to_x11_cursor(cursor_type), NULL, 0);
+#define CreateColourmap XCreateColormap
+#define CWColourmap CWColormap
 
-    if (!cursor_image)
+XImage* CursorOverlayWindow::create_shm_image(XShmSegmentInfo& shm_info, bool& huge_pages)
+{
+    if (!XShmQueryExtension(x11.display))
     {
         return nullptr;
     }
 
-    // the cursor image will have some transparent padding around it, so it'll need to be cropped
-    size_t start_x = cursor_image->width - 1;
-    size_t start_y = cursor_image->width - 1;
-    size_t end_x = 0;
-    size_t end_y = 0;
-
-    /*
-    Clip off the rows and columns where the alpha channel is 0 
-    0 00000 000
-    ___________
-    0 11111 000
-    0 11110 000
-    0 00110 000
-    0 00011 000
-    ___________
-    0 00000 000
-    */
-
-    for (size_t y = 0; y < cursor_image->height; y++)
-    {
-        bool row_not_empty = false;
-        size_t x = 0;
+    XImage* image = XShmCreateImage(x11.display, x11.visual_info.visual, 32, ZPixmap, nullptr, &shm_info, x11.monitor_region.width, x11.monitor_region.height);
 
-        for (; x < cursor_image->width; x++)
-        {
-            uint8_t alpha = cursor_image->pixels[y * cursor_image->width + x] >> 24;
-
-            if(alpha != 0)
-            {
-                row_not_empty = true;
-
-                break;
-            }
-        }
-
-        if (row_not_empty)
-        {
-            if(y < start_y) start_y = y;                
-            if(x < start_x) start_x = x;
-        }
-    }
-
-    for (size_t y = cursor_image->height; y-- != 0;)
+    if (!image)
     {
-        bool row_not_empty = false;
-        size_t x = cursor_image->width;
-
-        while (x-- != 0)
-        {
-            uint8_t alpha = cursor_image->pixels[y * cursor_image->width + x] >> 24;
-
-            if(alpha != 0)
-            {
-                row_not_empty = true;
-
-                break;
-            }
-        }
-
-        if (row_not_empty)
-        {
-            if(y > end_y) end_y = y;        
-            if(x > end_x) end_x = x;
-        }
+        return nullptr;
     }
 
-    size_t cursor_width = (end_x - start_x) + 1;
-    size_t cursor_height = (end_y - start_y) + 1;
+    size_t size = image->bytes_per_line * image->height;
 
-    // should use new keyword in C++ but since X11 is a C API...
-    uint32_t* pixels = (uint32_t*)malloc(cursor_width * cursor_height * sizeof(uint32_t));
+    // a monitor sized segment is several huge pages, try them first and fall back when none are reserved
+    size_t huge_page_size = 2 * 1024 * 1024;
 
-    if(!pixels) return nullptr;
+    shm_info.shmid = shmget(IPC_PRIVATE, round_up_div(size, huge_page_size) * huge_page_size, IPC_CREAT | SHM_HUGETLB | 0600);
+    huge_pages = shm_info.shmid >= 0;
 
-    for(size_t y = 0; y < cursor_height; y++)
+    if (!huge_pages)
     {
-        for(size_t x = 0; x < cursor_width; x++)
-        {
-            pixels[y * cursor_width + x] = cursor_image->pixels[(start_y + y) * cursor_image->width + (start_x + x)];
-        }
+        shm_info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
     }
 
-    XImage* mouse_image = XCreateImage(x11.display, x11.visual_info.visual, 32, ZPixmap, 0, reinterpret_cast<char*>(pixels), cursor_width, cursor_height, 32, 0);
+    if (shm_info.shmid < 0)
+    {
+        XDestroyImage(image);
 
-    XcursorImageDestroy(cursor_image);
+        return nullptr;
+    }
 
-    return mouse_image;
-}
+    shm_info.shmaddr = image->data = (char*)shmat(shm_info.shmid, nullptr, 0);
+    shm_info.readOnly = False;
 
-CursorPixel::CursorPixel(X11State& state, CursorPixel::cursor_list cursor_shades)
-:
-x11(state),
-_max_width(0),
-_max_height(0)
-{
-    if(cursor_shades.size() == 0)
+    if (shm_info.shmaddr == (char*)-1)
     {
-        std::cerr << "error: no cursor list provided to CursorPixel()" << std::endl;
+        shmctl(shm_info.shmid, IPC_RMID, nullptr);
+        XDestroyImage(image);
 
-        std::exit(EXIT_FAILURE);
+        return nullptr;
     }
 
-    for (CursorType type : cursor_shades)
-    {
-        XImage* mouse_image = get_mouse_image(type);
-
-        if(!mouse_image)
-        {
-            std::cerr << "error: could not get mouse cursor image" << std::endl;
+    // the server reports a failed attach (eg. when it is on another machine) asynchronously, so sync and catch it
+    XSync(x11.display, False);
 
-            CursorPixel::~CursorPixel();
+    shm_attach_failed = false;
 
-            std::exit(EXIT_FAILURE);
-        }
+    XErrorHandler previous_handler = XSetErrorHandler(shm_error_handler);
 
-        if(mouse_image->width > _max_width) _max_width = mouse_image->width;
-        if(mouse_image->height > _max_height) _max_height = mouse_image->height;
+    XShmAttach(x11.display, &shm_info);
+    XSync(x11.display, False);
+    XSetErrorHandler(previous_handler);
 
-        _image_shades.push_back(mouse_image);
-    }
-}
+    // the segment is only destroyed after both us and the server detach, so it can't leak if we crash
+    shmctl(shm_info.shmid, IPC_RMID, nullptr);
 
-CursorPixel::~CursorPixel()
-{
-    for (XImage* image : _image_shades)
+    if (shm_attach_failed)
     {
+        shmdt(shm_info.shmaddr);
         XDestroyImage(image);
-    }
-}
 
+        return nullptr;
+    }
 
-#define CreateColourmap XCreateColormap
-#define CWColourmap CWColormap
+    return image;
+}
 
-int CursorOverlayWindow::create_window()
+Window create_overlay_window(X11State& x11)
 {
     XSetWindowAttributes attrs;
 
@@ -180,85 +113,257 @@ int CursorOverlayWindow::create_window()
     attrs.background_pixel = BlackPixel(x11.display, x11.screen_id);
     attrs.override_redirect = true;
 
-    _window = XCreateWindow(x11.display, x11.root_window, x11.monitor_region.x, x11.monitor_region.y, x11.monitor_region.width, x11.monitor_region.height, 0, x11.visual_info.depth, InputOutput, x11.visual_info.visual,
+    Window window = XCreateWindow(x11.display, x11.root_window, x11.monitor_region.x, x11.monitor_region.y, x11.monitor_region.width, x11.monitor_region.height, 0, x11.visual_info.depth, InputOutput, x11.visual_info.visual,
                                     CWColourmap | CWBorderPixel | CWBackPixel | CWOverrideRedirect, &attrs);
 
-    if (_window == None)
+    if (window == None)
     {
-        std::cerr << "Could not create X11 window!" << std::endl;
-
-        return EXIT_FAILURE;
+        return None;
     }
 
     Atom window_type_atom = XInternAtom(x11.display, "_NET_WM_WINDOW_TYPE", false);
     Atom window_type_dock_atom = XInternAtom(x11.display, "_NET_WM_WINDOW_TYPE_DOCK", false);
     
-    XChangeProperty(x11.display, _window, window_type_atom, XA_ATOM, 32, PropModeReplace, (unsigned char*)&window_type_dock_atom, 1);
+    XChangeProperty(x11.display, window, window_type_atom, XA_ATOM, 32, PropModeReplace, (unsigned char*)&window_type_dock_atom, 1);
 
     // pass events (eg mouse, keyboard) to window behind instead of the overlay
     XserverRegion region = XFixesCreateRegion(x11.display, nullptr, 0);
 
-    XFixesSetWindowShapeRegion(x11.display, _window, ShapeInput, 0, 0, region);
+    XFixesSetWindowShapeRegion(x11.display, window, ShapeInput, 0, 0, region);
     XFixesDestroyRegion(x11.display, region);
 
-    XMapWindow(x11.display, _window);
+    XMapWindow(x11.display, window);
 
-    _gc = XCreateGC(x11.display, _window, 0, nullptr);
+    return window;
+}
 
-    uint32_t* frame_data = (uint32_t*)malloc(x11.monitor_region.width * x11.monitor_region.height * sizeof(uint32_t));
+int CursorOverlayWindow::create_window(bool allow_shm, size_t shm_buffers)
+{
+    _window = create_overlay_window(x11);
 
-    if(!frame_data)
+    if (_window == None)
     {
+        std::cerr << "Could not create X11 window!" << std::endl;
+
         return EXIT_FAILURE;
     }
 
-    _backbuffer = XCreateImage(x11.display, x11.visual_info.visual, 32, ZPixmap, 0, (char*)frame_data, x11.monitor_region.width, x11.monitor_region.height, 32, 0);
+    _gc = XCreateGC(x11.display, _window, 0, nullptr);
 
-    if(!_backbuffer)
+    if (allow_shm)
     {
-        return EXIT_FAILURE;
+        size_t buffer_count = std::max(shm_buffers, (size_t)1);
+
+        // the images keep a pointer to their segment info, so the buffers must never move
+        _shm_buffers.reserve(buffer_count);
+
+        // only reported when every segment got them, not just the last one
+        bool all_huge_pages = true;
+
+        for (size_t i = 0; i < buffer_count; i++)
+        {
+            _shm_buffers.push_back({ nullptr, {}, 0, {} });
+
+            ShmBuffer& buffer = _shm_buffers.back();
+
+            bool huge_pages = false;
+
+            buffer.image = create_shm_image(buffer.info, huge_pages);
+
+            // out of segments, carry on with the ones there are
+            if (!buffer.image)
+            {
+                _shm_buffers.pop_back();
+
+                break;
+            }
+
+            all_huge_pages = all_huge_pages && huge_pages;
+
+            std::memset(buffer.image->data, 0, buffer.image->bytes_per_line * buffer.image->height);
+
+            // at most one region per row of pixels per frame, for every other buffer's frames
+            buffer.stale_regions.reserve(x11.monitor_region.height * (buffer_count - 1));
+        }
+
+        _use_shm = !_shm_buffers.empty();
+        _huge_pages = _use_shm && all_huge_pages;
+        _completion_event = XShmGetEventBase(x11.display) + ShmCompletion;
+    }
+
+    if (!_use_shm)
+    {
+        // zeroed so the backbuffer starts out matching the blank window
+        _pixels.emplace(x11.monitor_region.width * x11.monitor_region.height);
+        _huge_pages = _pixels->huge_pages();
+
+        _backbuffer = XCreateImage(x11.display, x11.visual_info.visual, 32, ZPixmap, 0, (char*)_pixels->data(), x11.monitor_region.width, x11.monitor_region.height, 32, 0);
+
+        if(!_backbuffer)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        _backbuffer = _shm_buffers[0].image;
     }
 
+    _backbuffer_view.emplace((uint32_t*)_backbuffer->data, (size_t)_backbuffer->width, (size_t)_backbuffer->height);
+
     XFlush(x11.display);
 
     return EXIT_SUCCESS;
 }
 
-void CursorOverlayWindow::write_frame(const ImageBuffer<uint8_t>& data)
+void CursorOverlayWindow::wait_for_release(ShmBuffer& buffer)
 {
-    uint32_t* pixels = (uint32_t*)_backbuffer->data;
+    XEvent event;
 
-    for (size_t y = 0; y < data.height; y++)
-    {
-        for (size_t x = 0; x < data.width; x++)
-        {
-            XImage* mouse_image = _cursors.get_cursor_image(data.pixels[y * data.width + x]);
+    auto handle_completion = [&]() {
+        const XShmCompletionEvent& completion = reinterpret_cast<const XShmCompletionEvent&>(event);
 
-            if (mouse_image)
+        for (ShmBuffer& shm_buffer : _shm_buffers)
+        {
+            if (shm_buffer.info.shmseg == completion.shmseg && shm_buffer.pending_puts)
             {
-                size_t screen_x = x * _cursors.max_width();
-                size_t screen_y = y * _cursors.max_height();
-                size_t curs_width = std::min((size_t)_backbuffer->width - screen_x, (size_t)mouse_image->width);
-                size_t curs_height = std::min((size_t)_backbuffer->height - screen_y, (size_t)mouse_image->height);
-
-                for (size_t curs_y = 0; curs_y < curs_height; curs_y++)
-                {
-                    std::memcpy(&pixels[(screen_y + curs_y) * (size_t)_backbuffer->width + screen_x], &(((uint32_t*)mouse_image->data)[curs_y * mouse_image->width]), curs_width * sizeof(uint32_t));
-                }
+                shm_buffer.pending_puts--;
             }
         }
+    };
+
+    // completions which already arrived don't count as waiting
+    while (buffer.pending_puts && XCheckTypedEvent(x11.display, _completion_event, &event))
+    {
+        handle_completion();
+    }
+
+    if (!buffer.pending_puts)
+    {
+        return;
+    }
+
+    TRACE_SCOPE(WaitForBuffer);
+
+    auto wait_start = std::chrono::steady_clock::now();
+
+    while (buffer.pending_puts)
+    {
+        XIfEvent(x11.display, &event, is_event_type, (XPointer)&_completion_event);
+        handle_completion();
+    }
+
+    _last_buffer_wait = std::chrono::steady_clock::now() - wait_start;
+    _buffer_wait_time += _last_buffer_wait;
+    _buffer_waits++;
+}
+
+void CursorOverlayWindow::switch_buffer(size_t previous)
+{
+    ShmBuffer& buffer = _shm_buffers[_current_buffer];
+    const XImage* source = _shm_buffers[previous].image;
+
+    wait_for_release(buffer);
+
+    // the server only reads the previous buffer, so copying out of it while it is being blitted is fine
+    for (const RectangleRegion& region : buffer.stale_regions)
+    {
+        for (size_t y = region.y; y < region.y + region.height; y++)
+        {
+            size_t offset = y * buffer.image->bytes_per_line + region.x * sizeof(uint32_t);
+
+            std::memcpy(buffer.image->data + offset, source->data + offset, region.width * sizeof(uint32_t));
+        }
     }
+
+    buffer.stale_regions.clear();
+
+    _backbuffer = buffer.image;
+    _backbuffer_view.emplace((uint32_t*)_backbuffer->data, (size_t)_backbuffer->width, (size_t)_backbuffer->height);
 }
 
-void CursorOverlayWindow::swap_buffers()
+void CursorOverlayWindow::present(const std::vector<RectangleRegion>& dirty_regions)
 {
-    XPutImage(x11.display, _window, _gc, _backbuffer, 0, 0, 0, 0, x11.monitor_region.width, x11.monitor_region.height);
-    std::memset(_backbuffer->data, 0, x11.monitor_region.width * x11.monitor_region.height * sizeof(uint32_t));
+    if (!_use_shm)
+    {
+        for (const RectangleRegion& region : dirty_regions)
+        {
+            XPutImage(x11.display, _window, _gc, _backbuffer, region.x, region.y, region.x, region.y, region.width, region.height);
+
+            _bytes_sent += 24 + region.width * region.height * sizeof(uint32_t);
+        }
+
+        XFlush(x11.display);
+
+        return;
+    }
+
+    ShmBuffer& front = _shm_buffers[_current_buffer];
+    bool cycling = _shm_buffers.size() > 1;
+
+    for (const RectangleRegion& region : dirty_regions)
+    {
+        // with several buffers the server reports when it's done reading each put instead of us waiting for it
+        XShmPutImage(x11.display, _window, _gc, front.image, region.x, region.y, region.x, region.y, region.width, region.height, cycling ? True : False);
+
+        // only the request goes over the connection, the server reads the pixels out of the segment
+        _bytes_sent += 40;
+    }
+
+    if (!cycling)
+    {
+        // the server reads straight out of the segment, so it must be done before the next frame is written
+        XSync(x11.display, False);
+
+        return;
+    }
+
+    _last_buffer_wait = std::chrono::nanoseconds(0);
+
+    // nothing was sent, so the buffer is still free to compose into
+    if (dirty_regions.empty())
+    {
+        return;
+    }
+
+    front.pending_puts += dirty_regions.size();
+    XFlush(x11.display);
+
+    for (ShmBuffer& buffer : _shm_buffers)
+    {
+        if (&buffer != &front)
+        {
+            buffer.stale_regions.insert(buffer.stale_regions.end(), dirty_regions.begin(), dirty_regions.end());
+        }
+    }
+
+    size_t previous = _current_buffer;
+
+    _current_buffer = (_current_buffer + 1) % _shm_buffers.size();
+    switch_buffer(previous);
 }
 
 CursorOverlayWindow::~CursorOverlayWindow()
 {
     XDestroyWindow(x11.display, _window);
     XFreeGC(x11.display, _gc);
-    XDestroyImage(_backbuffer);
+
+    if (_use_shm)
+    {
+        // let the server finish reading every buffer before they go away
+        XSync(x11.display, False);
+
+        for (ShmBuffer& buffer : _shm_buffers)
+        {
+            XShmDetach(x11.display, &buffer.info);
+            XDestroyImage(buffer.image);
+            shmdt(buffer.info.shmaddr);
+        }
+    }
+    else if (_backbuffer)
+    {
+        // the pixels belong to _pixels, stop XDestroyImage from freeing them
+        _backbuffer->data = nullptr;
+        XDestroyImage(_backbuffer);
+    }
 }
@@ -1,73 +1,138 @@
 #pragma once
 
 #include <vector>
+#include <optional>
+#include <chrono>
 #include <cstdint>
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
 
 #include "x11/state.h"
+#include "render_sink.h"
+#include "aligned_buffer.h"
 
-class CursorPixel
+// creates a transparent, click-through window covering the monitor and maps it
+// returns None on failure
+Window create_overlay_window(X11State& x11);
+
+// Transparent, click-through window covering the monitor which frames are presented to
+class CursorOverlayWindow : public RenderSink
 {
 private:
     X11State& x11;
-    std::vector<XImage*> _image_shades;
-    size_t _max_width, _max_height;
+    Window _window;
+    GC _gc;
 
-    XImage* get_mouse_image(CursorType cursor_type);
+    // the buffer being composed into
+    XImage* _backbuffer;
+    std::optional<ImageBuffer<uint32_t>> _backbuffer_view;
 
-public:
-    using cursor_list = std::initializer_list<CursorType>;
+    // a shared memory image the server reads frames out of
+    struct ShmBuffer
+    {
+        XImage* image;
+        XShmSegmentInfo info;
 
-    CursorPixel(X11State& state, cursor_list cursor_shades);
+        // puts the server hasn't sent ShmCompletion for yet, the buffer can't be written until they're done
+        size_t pending_puts;
 
-    // Translates value out of 255 into an index
-    // which it uses to find a cursor in the cursors array.
-    // White shades (around 255ish) return null images 
-    XImage* get_cursor_image(uint8_t shade)
-    {
-        size_t index = (size_t)shade * (_image_shades.size() + 1) / 256;
+        // regions presented from other buffers since this one was last shown, copied in before it is reused
+        std::vector<RectangleRegion> stale_regions;
+    };
 
-        return index >= _image_shades.size() ? nullptr : _image_shades[index];
-    }
+    // with more than one buffer, frames are composed into the next while the server reads the last
+    std::vector<ShmBuffer> _shm_buffers;
+    size_t _current_buffer;
+    int _completion_event;
+    bool _use_shm;
+    bool _huge_pages;
 
-    size_t max_width() const { return _max_width; }
-    size_t max_height() const { return _max_height; }
+    // time spent waiting for the server to release the next buffer
+    size_t _buffer_waits;
+    std::chrono::nanoseconds _buffer_wait_time;
+    std::chrono::nanoseconds _last_buffer_wait;
 
-    ~CursorPixel();
-};
+    // the backbuffer's pixels when presenting with XPutImage, shared memory holds them otherwise
+    std::optional<AlignedBuffer<uint32_t>> _pixels;
+    uint64_t _bytes_sent;
 
-class CursorOverlayWindow
-{
-private:
-    X11State& x11;
-    Window _window;
-    GC _gc;
-    CursorPixel _cursors;
-    XImage* _backbuffer;
+    // allocates an image inside a shared memory segment which the X server attaches to
+    // returns null if MIT-SHM is unavailable (eg. remote displays)
+    // huge_pages: set when the segment is backed by reserved huge pages
+    XImage* create_shm_image(XShmSegmentInfo& shm_info, bool& huge_pages);
+
+    // handles ShmCompletion events until the buffer is released
+    void wait_for_release(ShmBuffer& buffer);
+
+    // makes _current_buffer the backbuffer, bringing it up to date with the frame just presented
+    void switch_buffer(size_t previous);
 
 public:
-    CursorOverlayWindow(X11State& state, CursorPixel::cursor_list cursors)
+    CursorOverlayWindow(X11State& state)
     :
     x11(state),
     _window(None),
-    _cursors(x11, cursors),
-    _backbuffer(nullptr)
+    _backbuffer(nullptr),
+    _current_buffer(0),
+    _completion_event(0),
+    _use_shm(false),
+    _huge_pages(false),
+    _buffer_waits(0),
+    _buffer_wait_time(0),
+    _last_buffer_wait(0),
+    _bytes_sent(0)
+    {
+    }
+
+    // allow_shm: try presenting through MIT-SHM before falling back to XPutImage
+    // shm_buffers: shared memory images to cycle through, 1 waits for the server to finish every frame
+    int create_window(bool allow_shm = true, size_t shm_buffers = 2);
+
+    ImageBuffer<uint32_t>& backbuffer() override
+    {
+        return *_backbuffer_view;
+    }
+
+    void present(const std::vector<RectangleRegion>& dirty_regions) override;
+
+    uint64_t bytes_sent() const override
+    {
+        return _bytes_sent;
+    }
+
+    bool using_shm() const
     {
+        return _use_shm;
     }
 
-    int create_window();
+    // shared memory images in use, 0 without MIT-SHM
+    size_t shm_buffer_count() const
+    {
+        return _shm_buffers.size();
+    }
 
-    void write_frame(const ImageBuffer<uint8_t>& data);
-    void swap_buffers();
+    // times present() had to wait for the server to release the next buffer, and how long in total
+    size_t buffer_waits() const
+    {
+        return _buffer_waits;
+    }
 
-    size_t get_width() const
+    std::chrono::nanoseconds buffer_wait_time() const
     {
-        return round_up_div((size_t)_backbuffer->width, _cursors.max_width());
+        return _buffer_wait_time;
     }
 
-    size_t get_height() const
+    // time the last present() waited, 0 if the buffer was already free
+    std::chrono::nanoseconds last_buffer_wait() const
     {
-        return round_up_div((size_t)_backbuffer->height, _cursors.max_height());
+        return _last_buffer_wait;
+    }
+
+    // every buffer the frames are composed into is backed by reserved huge pages
+    bool using_huge_pages() const
+    {
+        return _huge_pages;
     }
 
     ~CursorOverlayWindow();
-};
\ No newline at end of file
+};
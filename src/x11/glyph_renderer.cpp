@@ -0,0 +1,290 @@
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "x11/glyph_renderer.h"
+#include "x11/cursor_window.h"
+#include "trace.h"
+
+namespace
+{
+    // keeps each CompositeGlyphs request well under the core protocol's maximum request size
+    const size_t max_request_bytes = 128 * 1024;
+
+    // glyph elements hold at most 254 glyphs on the wire, Xrender splits longer runs
+    size_t glyph_run_bytes(size_t glyph_count)
+    {
+        return 8 * ((glyph_count + 253) / 254) + 4 * glyph_count;
+    }
+}
+
+GlyphSetRenderer::GlyphSetRenderer(X11State& state, const CursorPixel& cursors)
+:
+x11(state),
+_cursors(cursors),
+_window(None),
+_window_picture(None),
+_glyph_set(None),
+_dirty_cells(0),
+_shade_runs(cursors.count()),
+_bytes_sent(0)
+{
+    // every cell starts out blank, the same as the window
+    _previous_indices.assign(get_width() * get_height(), (uint8_t)_cursors.count());
+}
+
+int GlyphSetRenderer::create_window()
+{
+    int event_base, error_base;
+
+    if (!XRenderQueryExtension(x11.display, &event_base, &error_base))
+    {
+        std::cerr << "The X server does not support XRender" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    _window = create_overlay_window(x11);
+
+    if (_window == None)
+    {
+        std::cerr << "Could not create X11 window!" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    _window_picture = XRenderCreatePicture(x11.display, _window, XRenderFindVisualFormat(x11.display, x11.visual_info.visual), 0, nullptr);
+
+    if (!upload_shades())
+    {
+        std::cerr << "Could not upload the cursor shades as glyphs" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    XFlush(x11.display);
+
+    return EXIT_SUCCESS;
+}
+
+bool GlyphSetRenderer::upload_shades()
+{
+    XRenderPictFormat* alpha_format = XRenderFindStandardFormat(x11.display, PictStandardA8);
+    XRenderPictFormat* colour_format = XRenderFindStandardFormat(x11.display, PictStandardARGB32);
+
+    if (!alpha_format || !colour_format)
+    {
+        return false;
+    }
+
+    const size_t cell_width = _cursors.max_width();
+    const size_t cell_height = _cursors.max_height();
+
+    _glyph_set = XRenderCreateGlyphSet(x11.display, alpha_format);
+
+    for (size_t index = 0; index < _cursors.count(); index++)
+    {
+        const ImageBuffer<uint32_t>& shade = *_cursors.get_image(index);
+
+        // A8 glyph rows are padded to 4 bytes
+        size_t alpha_stride = (shade.width + 3) & ~(size_t)3;
+        std::vector<char> alpha(alpha_stride * shade.height);
+
+        // the source tile is a whole cell, so repeating it lines up with every cell on screen
+        std::vector<uint32_t> colours(cell_width * cell_height, 0xff000000);
+
+        for (size_t y = 0; y < shade.height; y++)
+        {
+            for (size_t x = 0; x < shade.width; x++)
+            {
+                uint32_t pixel = shade.pixels[y * shade.width + x];
+                uint32_t a = pixel >> 24;
+
+                alpha[y * alpha_stride + x] = (char)a;
+
+                if (!a) continue;
+
+                // the glyph multiplies the alpha back in
+                uint32_t r = std::min<uint32_t>(((pixel >> 16) & 0xff) * 255 / a, 255);
+                uint32_t g = std::min<uint32_t>(((pixel >> 8) & 0xff) * 255 / a, 255);
+                uint32_t b = std::min<uint32_t>((pixel & 0xff) * 255 / a, 255);
+
+                colours[y * cell_width + x] = 0xff000000 | r << 16 | g << 8 | b;
+            }
+        }
+
+        XGlyphInfo glyph_info;
+
+        glyph_info.width = shade.width;
+        glyph_info.height = shade.height;
+        glyph_info.x = 0;
+        glyph_info.y = 0;
+
+        // advancing by a cell means a run of the same shade along a row is a single element
+        glyph_info.xOff = cell_width;
+        glyph_info.yOff = 0;
+
+        Glyph glyph_id = index;
+
+        XRenderAddGlyphs(x11.display, _glyph_set, &glyph_id, &glyph_info, 1, alpha.data(), alpha.size());
+
+        Pixmap pixmap = XCreatePixmap(x11.display, _window, cell_width, cell_height, 32);
+        XImage* image = XCreateImage(x11.display, x11.visual_info.visual, 32, ZPixmap, 0, (char*)colours.data(), cell_width, cell_height, 32, 0);
+
+        if (!image)
+        {
+            XFreePixmap(x11.display, pixmap);
+
+            return false;
+        }
+
+        GC gc = XCreateGC(x11.display, pixmap, 0, nullptr);
+
+        XPutImage(x11.display, pixmap, gc, image, 0, 0, 0, 0, cell_width, cell_height);
+        XFreeGC(x11.display, gc);
+
+        // the pixels belong to the vector
+        image->data = nullptr;
+        XDestroyImage(image);
+
+        XRenderPictureAttributes attributes;
+
+        attributes.repeat = RepeatNormal;
+
+        _source_pixmaps.push_back(pixmap);
+        _source_pictures.push_back(XRenderCreatePicture(x11.display, pixmap, colour_format, CPRepeat, &attributes));
+        _glyph_ids.emplace_back(get_width(), (unsigned int)index);
+    }
+
+    return true;
+}
+
+void GlyphSetRenderer::write_frame(const ImageBuffer<uint8_t>& indices)
+{
+    TRACE_SCOPE(Compose);
+
+    const int cell_width = _cursors.max_width();
+    const int cell_height = _cursors.max_height();
+    const size_t blank_index = _cursors.count();
+
+    _clear_rectangles.clear();
+
+    for (std::vector<XGlyphElt32>& runs : _shade_runs)
+    {
+        runs.clear();
+    }
+
+    _dirty_cells = 0;
+
+    for (size_t y = 0; y < indices.height; y++)
+    {
+        const uint8_t* row = &indices.pixels[y * indices.width];
+        uint8_t* previous_row = &_previous_indices[y * indices.width];
+        size_t x = 0;
+
+        while (x < indices.width)
+        {
+            if (row[x] == previous_row[x])
+            {
+                x++;
+
+                continue;
+            }
+
+            // a span of changed cells is cleared with one rectangle, then redrawn as runs of equal shades
+            size_t span_start = x;
+
+            while (x < indices.width && row[x] != previous_row[x])
+            {
+                previous_row[x] = row[x];
+                x++;
+            }
+
+            _dirty_cells += x - span_start;
+            _clear_rectangles.push_back({ (short)(span_start * cell_width), (short)(y * cell_height),
+                                          (unsigned short)((x - span_start) * cell_width), (unsigned short)cell_height });
+
+            for (size_t run_start = span_start; run_start < x;)
+            {
+                uint8_t index = row[run_start];
+                size_t run_end = run_start + 1;
+
+                while (run_end < x && row[run_end] == index) run_end++;
+
+                // positions are absolute here, present() makes them relative to the previous run
+                if (index != blank_index)
+                {
+                    _shade_runs[index].push_back({ _glyph_set, _glyph_ids[index].data(), (int)(run_end - run_start), (int)run_start * cell_width, (int)y * cell_height });
+                }
+
+                run_start = run_end;
+            }
+        }
+    }
+}
+
+void GlyphSetRenderer::present()
+{
+    TRACE_SCOPE(Present);
+
+    if (!_clear_rectangles.empty())
+    {
+        XRenderColor transparent = { 0, 0, 0, 0 };
+
+        XRenderFillRectangles(x11.display, PictOpSrc, _window_picture, &transparent, _clear_rectangles.data(), _clear_rectangles.size());
+
+        _bytes_sent += 20 + 8 * _clear_rectangles.size();
+    }
+
+    const int cell_width = _cursors.max_width();
+
+    for (size_t index = 0; index < _shade_runs.size(); index++)
+    {
+        std::vector<XGlyphElt32>& runs = _shade_runs[index];
+        size_t request_start = 0;
+
+        while (request_start < runs.size())
+        {
+            size_t request_bytes = 28;
+            size_t request_end = request_start;
+
+            while (request_end < runs.size() && (request_end == request_start || request_bytes + glyph_run_bytes(runs[request_end].nchars) < max_request_bytes))
+            {
+                request_bytes += glyph_run_bytes(runs[request_end].nchars);
+                request_end++;
+            }
+
+            // the first run is placed absolutely, the rest relative to where the previous run's glyphs ended
+            int first_x = runs[request_start].xOff;
+            int first_y = runs[request_start].yOff;
+
+            for (size_t i = request_end - 1; i > request_start; i--)
+            {
+                runs[i].xOff -= runs[i - 1].xOff + runs[i - 1].nchars * cell_width;
+                runs[i].yOff -= runs[i - 1].yOff;
+            }
+
+            // the source lines up with the screen, so its tile starts at every cell
+            XRenderCompositeText32(x11.display, PictOpOver, _source_pictures[index], _window_picture, nullptr,
+                                   first_x, first_y, first_x, first_y, &runs[request_start], request_end - request_start);
+
+            _bytes_sent += request_bytes;
+            request_start = request_end;
+        }
+    }
+
+    XFlush(x11.display);
+}
+
+GlyphSetRenderer::~GlyphSetRenderer()
+{
+    for (Picture picture : _source_pictures) XRenderFreePicture(x11.display, picture);
+    for (Pixmap pixmap : _source_pixmaps) XFreePixmap(x11.display, pixmap);
+
+    if (_glyph_set != None) XRenderFreeGlyphSet(x11.display, _glyph_set);
+    if (_window_picture != None) XRenderFreePicture(x11.display, _window_picture);
+    if (_window != None) XDestroyWindow(x11.display, _window);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+#include "x11/state.h"
+#include "x11/cursor_pixel.h"
+#include "frame_renderer.h"
+
+// Uploads every cursor shade to the X server once as an XRender glyph, then draws
+// frames by sending only the glyph of each cell which changed, a few bytes per cell
+// instead of all of its pixels.
+//
+// Glyphs are A8 masks of the shades' alpha. Each shade is drawn through its own
+// repeating source picture holding its un-premultiplied colours, tiled to the cell
+// grid, so source IN mask reproduces the premultiplied cursor pixels exactly.
+class GlyphSetRenderer : public FrameRenderer
+{
+private:
+    X11State& x11;
+    const CursorPixel& _cursors;
+    Window _window;
+    Picture _window_picture;
+    GlyphSet _glyph_set;
+
+    // one repeating source picture per shade
+    std::vector<Pixmap> _source_pixmaps;
+    std::vector<Picture> _source_pictures;
+
+    // a row's worth of each shade's glyph id, which every run of that shade points into
+    std::vector<std::vector<unsigned int>> _glyph_ids;
+
+    // cursor index each cell was last drawn with, so unchanged cells can be skipped
+    std::vector<uint8_t> _previous_indices;
+    size_t _dirty_cells;
+
+    // requests built by write_frame() and sent by present()
+    // changed cells are cleared first, then each shade's runs are drawn over them
+    std::vector<XRectangle> _clear_rectangles;
+    std::vector<std::vector<XGlyphElt32>> _shade_runs;
+    uint64_t _bytes_sent;
+
+    bool upload_shades();
+
+public:
+    GlyphSetRenderer(X11State& state, const CursorPixel& cursors);
+    GlyphSetRenderer(const GlyphSetRenderer&) = delete;
+
+    // creates the window and uploads the glyphs, fails if the server has no XRender
+    int create_window();
+
+    void write_frame(const ImageBuffer<uint8_t>& indices) override;
+    void present() override;
+
+    size_t dirty_cells() const override
+    {
+        return _dirty_cells;
+    }
+
+    size_t get_width() const override
+    {
+        return round_up_div(x11.monitor_region.width, _cursors.max_width());
+    }
+
+    size_t get_height() const override
+    {
+        return round_up_div(x11.monitor_region.height, _cursors.max_height());
+    }
+
+    uint64_t bytes_sent() const override
+    {
+        return _bytes_sent;
+    }
+
+    ~GlyphSetRenderer();
+};
@@ -0,0 +1,175 @@
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "x11/pixmap_renderer.h"
+#include "x11/cursor_window.h"
+#include "trace.h"
+
+PixmapTileRenderer::PixmapTileRenderer(X11State& state, const CursorPixel& cursors)
+:
+x11(state),
+_cursors(cursors),
+_window(None),
+_dirty_cells(0),
+_runs(cursors.count() + 1),
+_bytes_sent(0)
+{
+    // every cell starts out blank, the same as the window
+    _previous_indices.assign(get_width() * get_height(), (uint8_t)_cursors.count());
+}
+
+int PixmapTileRenderer::create_window()
+{
+    _window = create_overlay_window(x11);
+
+    if (_window == None)
+    {
+        std::cerr << "Could not create X11 window!" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    if (!upload_shades())
+    {
+        std::cerr << "Could not upload the cursor shades as pixmaps" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    XFlush(x11.display);
+
+    return EXIT_SUCCESS;
+}
+
+bool PixmapTileRenderer::upload_shades()
+{
+    const size_t cell_width = _cursors.max_width();
+    const size_t cell_height = _cursors.max_height();
+
+    // the tile covers the whole cell, so filling a cell also clears what the previous shade left around a smaller one
+    std::vector<uint32_t> tile_pixels(cell_width * cell_height);
+
+    for (size_t index = 0; index < _cursors.count(); index++)
+    {
+        const ImageBuffer<uint32_t>& shade = *_cursors.get_image(index);
+
+        std::fill(tile_pixels.begin(), tile_pixels.end(), 0);
+
+        for (size_t y = 0; y < shade.height; y++)
+        {
+            std::copy(&shade.pixels[y * shade.width], &shade.pixels[(y + 1) * shade.width], &tile_pixels[y * cell_width]);
+        }
+
+        Pixmap tile = XCreatePixmap(x11.display, _window, cell_width, cell_height, x11.visual_info.depth);
+        XImage* image = XCreateImage(x11.display, x11.visual_info.visual, x11.visual_info.depth, ZPixmap, 0, (char*)tile_pixels.data(), cell_width, cell_height, 32, 0);
+
+        if (!image)
+        {
+            XFreePixmap(x11.display, tile);
+
+            return false;
+        }
+
+        XGCValues values;
+
+        values.fill_style = FillTiled;
+        values.tile = tile;
+        values.ts_x_origin = 0;
+        values.ts_y_origin = 0;
+
+        GC gc = XCreateGC(x11.display, _window, GCFillStyle | GCTile | GCTileStipXOrigin | GCTileStipYOrigin, &values);
+
+        XPutImage(x11.display, tile, gc, image, 0, 0, 0, 0, cell_width, cell_height);
+
+        // the pixels belong to the vector
+        image->data = nullptr;
+        XDestroyImage(image);
+
+        _tiles.push_back(tile);
+        _gcs.push_back(gc);
+    }
+
+    XGCValues values;
+
+    values.foreground = 0;
+    values.fill_style = FillSolid;
+
+    _gcs.push_back(XCreateGC(x11.display, _window, GCForeground | GCFillStyle, &values));
+
+    return true;
+}
+
+void PixmapTileRenderer::write_frame(const ImageBuffer<uint8_t>& indices)
+{
+    TRACE_SCOPE(Compose);
+
+    const size_t cell_width = _cursors.max_width();
+    const size_t cell_height = _cursors.max_height();
+
+    for (std::vector<XRectangle>& runs : _runs)
+    {
+        runs.clear();
+    }
+
+    _dirty_cells = 0;
+
+    for (size_t y = 0; y < indices.height; y++)
+    {
+        const uint8_t* row = &indices.pixels[y * indices.width];
+        uint8_t* previous_row = &_previous_indices[y * indices.width];
+        size_t x = 0;
+
+        while (x < indices.width)
+        {
+            uint8_t index = row[x];
+
+            if (index == previous_row[x])
+            {
+                x++;
+
+                continue;
+            }
+
+            // neighbouring changed cells with the same shade are one rectangle
+            size_t run_start = x;
+
+            while (x < indices.width && row[x] == index && previous_row[x] != index)
+            {
+                previous_row[x] = index;
+                x++;
+            }
+
+            _dirty_cells += x - run_start;
+            _runs[index].push_back({ (short)(run_start * cell_width), (short)(y * cell_height),
+                                     (unsigned short)((x - run_start) * cell_width), (unsigned short)cell_height });
+        }
+    }
+}
+
+void PixmapTileRenderer::present()
+{
+    TRACE_SCOPE(Present);
+
+    for (size_t i = 0; i < _runs.size(); i++)
+    {
+        if (_runs[i].empty()) continue;
+
+        // Xlib splits the rectangles over several requests if they don't fit in one
+        XFillRectangles(x11.display, _window, _gcs[i], _runs[i].data(), _runs[i].size());
+
+        _bytes_sent += 12 + 8 * _runs[i].size();
+    }
+
+    XFlush(x11.display);
+}
+
+PixmapTileRenderer::~PixmapTileRenderer()
+{
+    for (GC gc : _gcs) XFreeGC(x11.display, gc);
+    for (Pixmap tile : _tiles) XFreePixmap(x11.display, tile);
+
+    if (_window != None) XDestroyWindow(x11.display, _window);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <X11/Xlib.h>
+
+#include "x11/state.h"
+#include "x11/cursor_pixel.h"
+#include "frame_renderer.h"
+
+// Core protocol backend for servers without XRender: every cursor shade is
+// uploaded once into a cell sized server-side pixmap, and frames are drawn by
+// tiling those pixmaps into the changed cells, with no client-side backbuffer.
+//
+// Each shade has a GC which fills with its pixmap as the tile, anchored at the
+// window origin so tiles line up with the cell grid. All the runs of a shade in
+// a frame then go out as a single XFillRectangles, and cleared cells as one more.
+class PixmapTileRenderer : public FrameRenderer
+{
+private:
+    X11State& x11;
+    const CursorPixel& _cursors;
+    Window _window;
+
+    // one tile and GC per shade, plus a solid transparent GC for blank cells at the end
+    std::vector<Pixmap> _tiles;
+    std::vector<GC> _gcs;
+
+    // cursor index each cell was last drawn with, so unchanged cells can be skipped
+    std::vector<uint8_t> _previous_indices;
+    size_t _dirty_cells;
+
+    // runs of changed cells for each GC, built by write_frame() and sent by present()
+    std::vector<std::vector<XRectangle>> _runs;
+    uint64_t _bytes_sent;
+
+    bool upload_shades();
+
+public:
+    PixmapTileRenderer(X11State& state, const CursorPixel& cursors);
+    PixmapTileRenderer(const PixmapTileRenderer&) = delete;
+
+    int create_window();
+
+    void write_frame(const ImageBuffer<uint8_t>& indices) override;
+    void present() override;
+
+    size_t dirty_cells() const override
+    {
+        return _dirty_cells;
+    }
+
+    size_t get_width() const override
+    {
+        return round_up_div(x11.monitor_region.width, _cursors.max_width());
+    }
+
+    size_t get_height() const override
+    {
+        return round_up_div(x11.monitor_region.height, _cursors.max_height());
+    }
+
+    uint64_t bytes_sent() const override
+    {
+        return _bytes_sent;
+    }
+
+    ~PixmapTileRenderer();
+};
@@ -0,0 +1,296 @@
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xpresent.h>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "x11/present_window.h"
+#include "x11/cursor_window.h"
+#include "trace.h"
+
+namespace
+{
+    // presents tracked per pixmap, completions rarely lag further than this
+    const size_t in_flight_per_pixmap = 4;
+
+    Bool is_generic_event(Display*, XEvent* event, XPointer)
+    {
+        return event->type == GenericEvent;
+    }
+}
+
+PresentWindow::PresentWindow(X11State& state)
+:
+x11(state),
+_window(None),
+_gc(nullptr),
+_image(nullptr),
+_next_pixmap(0),
+_present_opcode(0),
+_event_context(0),
+_update_region(None),
+_serial(0),
+_last_msc(0),
+_completed_frames(0),
+_skipped_frames(0),
+_lost_frames(0),
+_last_latency(0),
+_total_latency(0),
+_max_latency(0),
+_pixmap_waits(0),
+_pixmap_wait_time(0),
+_bytes_sent(0)
+{
+}
+
+int PresentWindow::create_window(size_t pixmap_count)
+{
+    int event_base = 0;
+    int error_base = 0;
+
+    if (!XPresentQueryExtension(x11.display, &_present_opcode, &event_base, &error_base))
+    {
+        std::cerr << "The X server doesn't support the Present extension" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    _window = create_overlay_window(x11);
+
+    if (_window == None)
+    {
+        std::cerr << "Could not create X11 window!" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    _gc = XCreateGC(x11.display, _window, 0, nullptr);
+
+    const size_t width = x11.monitor_region.width;
+    const size_t height = x11.monitor_region.height;
+
+    // zeroed so the backbuffer starts out matching the blank window
+    _pixels.emplace(width * height);
+    _image = XCreateImage(x11.display, x11.visual_info.visual, 32, ZPixmap, 0, (char*)_pixels->data(), width, height, 32, 0);
+
+    if (!_image)
+    {
+        return EXIT_FAILURE;
+    }
+
+    _backbuffer_view.emplace(_pixels->data(), width, height);
+
+    XSetForeground(x11.display, _gc, 0);
+
+    pixmap_count = std::max(pixmap_count, (size_t)1);
+    _pixmaps.reserve(pixmap_count);
+
+    for (size_t i = 0; i < pixmap_count; i++)
+    {
+        // pixmaps start out with undefined contents, clear them to match the backbuffer
+        Pixmap pixmap = XCreatePixmap(x11.display, _window, width, height, x11.visual_info.depth);
+
+        XFillRectangle(x11.display, pixmap, _gc, 0, 0, width, height);
+
+        _pixmaps.push_back({ pixmap, true, {} });
+
+        // at most one region per row of pixels per frame, for every other pixmap's frames
+        _pixmaps.back().stale_regions.reserve(height * (pixmap_count - 1));
+    }
+
+    _update_region = XFixesCreateRegion(x11.display, nullptr, 0);
+    _update_rectangles.reserve(height);
+
+    // enough for every pixmap to be in flight with room to spare, present() never tracks more
+    _in_flight.reserve(pixmap_count * in_flight_per_pixmap);
+
+    _event_context = XPresentSelectInput(x11.display, _window, PresentCompleteNotifyMask | PresentIdleNotifyMask);
+
+    XFlush(x11.display);
+
+    return EXIT_SUCCESS;
+}
+
+void PresentWindow::handle_event(XEvent& event)
+{
+    if (event.type != GenericEvent || event.xcookie.extension != _present_opcode || !XGetEventData(x11.display, &event.xcookie))
+    {
+        return;
+    }
+
+    if (event.xcookie.evtype == PresentCompleteNotify)
+    {
+        const XPresentCompleteNotifyEvent& complete = *static_cast<const XPresentCompleteNotifyEvent*>(event.xcookie.data);
+        auto present = std::find_if(_in_flight.begin(), _in_flight.end(), [&](const InFlightPresent& in_flight) {
+            return in_flight.serial == complete.serial_number;
+        });
+
+        // only pixmap presents carry a serial of ours, MSC notifies aren't asked for
+        if (complete.kind == PresentCompleteKindPixmap && present != _in_flight.end())
+        {
+            _last_msc = complete.msc;
+
+            if (complete.mode == PresentCompleteModeSkip)
+            {
+                _skipped_frames++;
+            }
+            else
+            {
+                auto now = std::chrono::steady_clock::now();
+
+                // UST counts the monotonic clock in microseconds, the same clock as steady_clock on Linux
+                std::chrono::steady_clock::time_point shown(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::microseconds(complete.ust)));
+
+                // servers without a usable UST get the time the event arrived instead
+                if (complete.ust == 0 || shown < present->sent || shown > now)
+                {
+                    shown = now;
+                }
+
+                _last_latency = shown - present->sent;
+                _total_latency += _last_latency;
+                _max_latency = std::max(_max_latency, _last_latency);
+                _completed_frames++;
+            }
+
+            _in_flight.erase(present);
+        }
+    }
+    else if (event.xcookie.evtype == PresentIdleNotify)
+    {
+        const XPresentIdleNotifyEvent& idle = *static_cast<const XPresentIdleNotifyEvent*>(event.xcookie.data);
+
+        for (PresentPixmap& pixmap : _pixmaps)
+        {
+            if (pixmap.pixmap == idle.pixmap)
+            {
+                pixmap.idle = true;
+            }
+        }
+    }
+
+    XFreeEventData(x11.display, &event.xcookie);
+}
+
+size_t PresentWindow::wait_for_next_pixmap()
+{
+    // the first idle pixmap would keep picking the same two, leaving the rest to pile up stale regions forever
+    PresentPixmap& pixmap = _pixmaps[_next_pixmap];
+
+    if (pixmap.idle)
+    {
+        return _next_pixmap;
+    }
+
+    TRACE_SCOPE(WaitForBuffer);
+
+    auto wait_start = std::chrono::steady_clock::now();
+    XEvent event;
+
+    while (!pixmap.idle)
+    {
+        XIfEvent(x11.display, &event, is_generic_event, nullptr);
+        handle_event(event);
+    }
+
+    _pixmap_wait_time += std::chrono::steady_clock::now() - wait_start;
+    _pixmap_waits++;
+
+    return _next_pixmap;
+}
+
+void PresentWindow::present(const std::vector<RectangleRegion>& dirty_regions)
+{
+    // nothing changed, the pixmap on screen is still right
+    if (dirty_regions.empty())
+    {
+        return;
+    }
+
+    XEvent event;
+
+    // take in whatever the server sent since the last frame without blocking
+    while (XCheckTypedEvent(x11.display, GenericEvent, &event))
+    {
+        handle_event(event);
+    }
+
+    PresentPixmap& target = _pixmaps[wait_for_next_pixmap()];
+
+    auto upload = [&](const RectangleRegion& region) {
+        XPutImage(x11.display, target.pixmap, _gc, _image, region.x, region.y, region.x, region.y, region.width, region.height);
+
+        _bytes_sent += 24 + region.width * region.height * sizeof(uint32_t);
+    };
+
+    // bring the pixmap up to the last frame, then add this one's changes
+    for (const RectangleRegion& region : target.stale_regions)
+    {
+        upload(region);
+    }
+
+    target.stale_regions.clear();
+    _update_rectangles.clear();
+
+    for (const RectangleRegion& region : dirty_regions)
+    {
+        upload(region);
+
+        _update_rectangles.push_back({ (short)region.x, (short)region.y, (unsigned short)region.width, (unsigned short)region.height });
+    }
+
+    // only the update region has to be copied to the window when the server can't flip
+    XFixesSetRegion(x11.display, _update_region, _update_rectangles.data(), (int)_update_rectangles.size());
+
+    // 0 before the first completion, which the server also shows at the next vblank
+    uint64_t target_msc = _last_msc ? _last_msc + 1 : 0;
+
+    _serial++;
+
+    XPresentPixmap(x11.display, _window, target.pixmap, _serial, None, _update_region, 0, 0, None, None, None, PresentOptionNone, target_msc, 0, 0, nullptr, 0);
+
+    _bytes_sent += 8 + 8 * _update_rectangles.size() + 72;
+
+    target.idle = false;
+    _next_pixmap = (_next_pixmap + 1) % _pixmaps.size();
+    // an unmapped window or a switched off CRTC may never complete the oldest presents, stop waiting for them
+    if (_in_flight.size() == _pixmaps.size() * in_flight_per_pixmap)
+    {
+        _in_flight.erase(_in_flight.begin());
+        _lost_frames++;
+    }
+
+    _in_flight.push_back({ _serial, std::chrono::steady_clock::now() });
+
+    for (PresentPixmap& pixmap : _pixmaps)
+    {
+        if (&pixmap != &target)
+        {
+            pixmap.stale_regions.insert(pixmap.stale_regions.end(), dirty_regions.begin(), dirty_regions.end());
+        }
+    }
+
+    XFlush(x11.display);
+}
+
+PresentWindow::~PresentWindow()
+{
+    if (_event_context) XPresentFreeInput(x11.display, _window, _event_context);
+    if (_update_region != None) XFixesDestroyRegion(x11.display, _update_region);
+
+    for (PresentPixmap& pixmap : _pixmaps)
+    {
+        XFreePixmap(x11.display, pixmap.pixmap);
+    }
+
+    if (_image)
+    {
+        // the pixels belong to _pixels, stop XDestroyImage from freeing them
+        _image->data = nullptr;
+        XDestroyImage(_image);
+    }
+
+    if (_gc) XFreeGC(x11.display, _gc);
+    if (_window != None) XDestroyWindow(x11.display, _window);
+}
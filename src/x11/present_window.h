@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xfixes.h>
+
+#include "x11/state.h"
+#include "render_sink.h"
+#include "aligned_buffer.h"
+
+// Overlay window which frames are shown on through the Present extension.
+//
+// Frames are composited on the client as with CursorOverlayWindow, then the changed
+// regions are uploaded into one of a few window sized pixmaps and XPresentPixmap shows
+// it at the next vblank (MSC), so frames never tear. A pixmap is only drawn into again
+// once the server's IdleNotify says it's done with it, and PresentCompleteNotify gives
+// the time each frame actually reached the screen.
+//
+// Servers without a real display (eg. Xvfb) still implement Present with a fake vblank.
+class PresentWindow : public RenderSink
+{
+private:
+    struct PresentPixmap
+    {
+        Pixmap pixmap;
+
+        // false from being presented until the server's IdleNotify for it
+        bool idle;
+
+        // regions presented from other pixmaps since this one was last shown, uploaded again before it is reused
+        std::vector<RectangleRegion> stale_regions;
+    };
+
+    // a present the server hasn't sent PresentCompleteNotify for yet
+    struct InFlightPresent
+    {
+        uint32_t serial;
+        std::chrono::steady_clock::time_point sent;
+    };
+
+    X11State& x11;
+    Window _window;
+    GC _gc;
+
+    // the client-side frame, uploaded into the pixmaps with XPutImage
+    std::optional<AlignedBuffer<uint32_t>> _pixels;
+    std::optional<ImageBuffer<uint32_t>> _backbuffer_view;
+    XImage* _image;
+
+    std::vector<PresentPixmap> _pixmaps;
+
+    // pixmaps are drawn into in turn, so each one only falls pixmap_count - 1 frames behind
+    size_t _next_pixmap;
+    int _present_opcode;
+    XID _event_context;
+
+    // the update region of each present, reused rather than created every frame
+    XserverRegion _update_region;
+    std::vector<XRectangle> _update_rectangles;
+
+    uint32_t _serial;
+
+    // the display's frame counter at the last completed present, frames are aimed at the one after
+    uint64_t _last_msc;
+    std::vector<InFlightPresent> _in_flight;
+
+    // present-to-complete latency of every frame the server showed
+    size_t _completed_frames;
+    size_t _skipped_frames;
+    size_t _lost_frames;
+    std::chrono::nanoseconds _last_latency;
+    std::chrono::nanoseconds _total_latency;
+    std::chrono::nanoseconds _max_latency;
+
+    // time spent waiting for the server to release a pixmap
+    size_t _pixmap_waits;
+    std::chrono::nanoseconds _pixmap_wait_time;
+
+    uint64_t _bytes_sent;
+
+    // handles the event if it is one of ours
+    void handle_event(XEvent& event);
+
+    // handles Present events until the next pixmap in turn is idle
+    // returns its index
+    size_t wait_for_next_pixmap();
+
+public:
+    PresentWindow(X11State& state);
+    PresentWindow(const PresentWindow&) = delete;
+
+    // pixmap_count: pixmaps to cycle through, 2 is enough to present at the display's rate
+    // returns EXIT_FAILURE if the server doesn't support Present
+    int create_window(size_t pixmap_count = 3);
+
+    ImageBuffer<uint32_t>& backbuffer() override
+    {
+        return *_backbuffer_view;
+    }
+
+    void present(const std::vector<RectangleRegion>& dirty_regions) override;
+
+    uint64_t bytes_sent() const override
+    {
+        return _bytes_sent;
+    }
+
+    size_t pixmap_count() const
+    {
+        return _pixmaps.size();
+    }
+
+    // frames the server reported as shown, and frames it replaced with a later one before they were
+    size_t completed_frames() const
+    {
+        return _completed_frames;
+    }
+
+    size_t skipped_frames() const
+    {
+        return _skipped_frames;
+    }
+
+    // frames given up on after the server sent no completion for them, eg. while the window was unmapped
+    size_t lost_frames() const
+    {
+        return _lost_frames;
+    }
+
+    // time from XPresentPixmap to the frame reaching the screen, for the latest completed frame
+    std::chrono::nanoseconds last_latency() const
+    {
+        return _last_latency;
+    }
+
+    std::chrono::nanoseconds average_latency() const
+    {
+        return _completed_frames ? _total_latency / (int64_t)_completed_frames : std::chrono::nanoseconds(0);
+    }
+
+    std::chrono::nanoseconds max_latency() const
+    {
+        return _max_latency;
+    }
+
+    // times present() had to wait for the server to release a pixmap, and how long in total
+    size_t pixmap_waits() const
+    {
+        return _pixmap_waits;
+    }
+
+    std::chrono::nanoseconds pixmap_wait_time() const
+    {
+        return _pixmap_wait_time;
+    }
+
+    ~PresentWindow();
+};
@@ -11,76 +11,99 @@
 
 X11State::X11State()
 {
-    display = XOpenDisplay(nullptr);
+    open_display();
+    find_monitors();
 
-    if (!display)
+    int mouse_x = 0, mouse_y = 0;
+    Window root_return, child_return;
+    int win_x_return, win_y_return;
+    uint32_t mask_return;
+
+    if (!XQueryPointer(display, root_window, &root_return, &child_return, &mouse_x, &mouse_y, &win_x_return, &win_y_return, &mask_return))
     {
-        std::cerr << "X11 display initialisation failed!" << std::endl;
+        std::cerr << "XQueryPointer failed" << std::endl;
 
         std::exit(EXIT_FAILURE);
     }
 
-    screen_id = DefaultScreen(display);
-    root_window = DefaultRootWindow(display);
+    const RectangleRegion* active_monitor = nullptr;
 
-    if(!XMatchVisualInfo(display, screen_id, 32, TrueColour, &visual_info))
+    for (const RectangleRegion& monitor : monitors)
     {
-        std::cerr << "XMatchVisualInfo failed" << std::endl;
+        if ((size_t)mouse_x >= monitor.x && (size_t)mouse_x < monitor.x + monitor.width &&
+        (size_t)mouse_y >= monitor.y && (size_t)mouse_y < monitor.y + monitor.height)
+        {
+            active_monitor = &monitor;
 
-        std::exit(EXIT_FAILURE);
+            break;
+        }
     }
 
+    if(!active_monitor)
     {
-        int mouse_x = 0, mouse_y = 0;
-        Window root_return, child_return;
-        int win_x_return, win_y_return;
-        uint32_t mask_return;
+        std::cerr << "Could not find active monitor" << std::endl;
 
-        if (!XQueryPointer(display, root_window, &root_return, &child_return, &mouse_x, &mouse_y, &win_x_return, &win_y_return, &mask_return))
-        {
-            std::cerr << "XQueryPointer failed" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
 
-            std::exit(EXIT_FAILURE);
-        }
+    printf("Monitor: x: %zu, y: %zu, width: %zu, height: %zu\n", active_monitor->x, active_monitor->y, active_monitor->width, active_monitor->height);
 
-        XRRScreenResources* screen_res = XRRGetScreenResourcesCurrent(display, root_window);
-        XRRCrtcInfo* active_monitor_info = nullptr;
+    monitor_region = *active_monitor;
+}
 
-        for (size_t i = 0; i < screen_res->ncrtc; i++)
-        {
-            XRRCrtcInfo* crtc_info = XRRGetCrtcInfo(display, screen_res, screen_res->crtcs[i]);
+X11State::X11State(const RectangleRegion& monitor)
+{
+    open_display();
+    find_monitors();
 
-            if(crtc_info &&
-            mouse_x >= crtc_info->x && mouse_x < crtc_info->x + crtc_info->width &&
-            mouse_y >= crtc_info->y && mouse_y < crtc_info->y + crtc_info->height)
-            {
-                active_monitor_info = crtc_info;
+    monitor_region = monitor;
+}
 
-                break;
-            }
+void X11State::open_display()
+{
+    display = XOpenDisplay(nullptr);
 
-            XRRFreeCrtcInfo(crtc_info);
-        }
+    if (!display)
+    {
+        std::cerr << "X11 display initialisation failed!" << std::endl;
 
-        if(!active_monitor_info)
-        {
-            std::cerr << "Could not find active monitor" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
 
-            std::exit(EXIT_FAILURE);
-        }
+    screen_id = DefaultScreen(display);
+    root_window = DefaultRootWindow(display);
+
+    if(!XMatchVisualInfo(display, screen_id, 32, TrueColour, &visual_info))
+    {
+        std::cerr << "XMatchVisualInfo failed" << std::endl;
 
-        printf("Monitor: x: %d, y: %d, width: %u, height: %u\n", active_monitor_info->x, active_monitor_info->y, active_monitor_info->width, active_monitor_info->height);
+        std::exit(EXIT_FAILURE);
+    }
+}
 
-        monitor_region = {
-            static_cast<size_t>(active_monitor_info->x),
-            static_cast<size_t>(active_monitor_info->y),
-            active_monitor_info->width,
-            active_monitor_info->height
-        };
+void X11State::find_monitors()
+{
+    XRRScreenResources* screen_res = XRRGetScreenResourcesCurrent(display, root_window);
 
-        XRRFreeCrtcInfo(active_monitor_info);
-        XRRFreeScreenResources(screen_res);
+    for (int i = 0; screen_res && i < screen_res->ncrtc; i++)
+    {
+        XRRCrtcInfo* crtc_info = XRRGetCrtcInfo(display, screen_res, screen_res->crtcs[i]);
+
+        // CRTCs without a mode aren't driving anything
+        if (crtc_info && crtc_info->mode != None && crtc_info->width && crtc_info->height)
+        {
+            monitors.push_back({
+                static_cast<size_t>(crtc_info->x),
+                static_cast<size_t>(crtc_info->y),
+                crtc_info->width,
+                crtc_info->height
+            });
+        }
+
+        XRRFreeCrtcInfo(crtc_info);
     }
+
+    XRRFreeScreenResources(screen_res);
 }
 
 X11State::~X11State()
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
@@ -11,10 +12,25 @@ struct X11State
     int screen_id;
     Window root_window;
     XVisualInfo visual_info;
+
+    // the monitor windows are placed on
     RectangleRegion monitor_region;
 
+    // every active monitor, in RandR CRTC order
+    std::vector<RectangleRegion> monitors;
+
+    // places windows on the monitor under the mouse pointer
     X11State();
+
+    // opens a connection of its own for drawing on the given monitor,
+    // so each monitor can be presented to from a separate thread without Xlib locking
+    X11State(const RectangleRegion& monitor);
+
     X11State(const X11State&) = delete;
 
     ~X11State();
+
+private:
+    void open_display();
+    void find_monitors();
 };